@@ -0,0 +1,50 @@
+#!/bin/sh
+# times the parser over reproducible generated JSON documents and prints the
+# throughput of every mode for every kind and size.
+# usage: bench/bench.sh [json_bench]    (defaults to bench/json_bench)
+#
+# KINDS      documents to generate (records numbers strings text, or deep wide), empty for only NDJSON
+# SIZES      document sizes in MB
+# MODES      json_bench modes to run, comma separated
+# NDJSON     json_bench modes to run on a generated NDJSON document of every size (none to skip)
+# THREADS    thread counts to run every mode on, comma separated (1,2,4 for a scaling run),
+#            the NDJSON document is split across the threads
+# RUNS       runs per measurement, the fastest is reported
+# CORPUS_DIR where the documents are kept between runs
+
+KINDS=${KINDS-records numbers strings text}
+SIZES=${SIZES:-16 128}
+MODES=${MODES:-index,validate,sax,stream,dom}
+NDJSON=${NDJSON:-ndjson,ndjson-dom}
+THREADS=${THREADS:-1}
+RUNS=${RUNS:-5}
+CORPUS_DIR=${CORPUS_DIR:-/tmp/ccjp_bench}
+
+dir=$(dirname "$0")
+bench=${1:-$dir/json_bench}
+
+mkdir -p "$CORPUS_DIR" || exit 1
+gen=$CORPUS_DIR/gen_json
+if [ ! -x "$gen" ] || [ "$dir/gen_json.c" -nt "$gen" ]; then
+    ${CC:-gcc} -O2 -Wall -o "$gen" "$dir/gen_json.c" || exit 1
+fi
+
+files=
+for kind in $KINDS; do
+    for size in $SIZES; do
+        doc=$CORPUS_DIR/$kind-$size.json
+        if [ ! -f "$doc" ]; then "$gen" "$kind" "$size" "$doc" || exit 1; fi
+        files="$files $doc"
+    done
+done
+if [ -n "$files" ]; then "$bench" -r "$RUNS" -t "$THREADS" "$MODES" $files || exit 1; fi
+
+if [ "$NDJSON" != none ]; then
+    files=
+    for size in $SIZES; do
+        doc=$CORPUS_DIR/ndjson-$size.json
+        if [ ! -f "$doc" ]; then "$gen" ndjson "$size" "$doc" || exit 1; fi
+        files="$files $doc"
+    done
+    "$bench" -r "$RUNS" -t "$THREADS" "$NDJSON" $files
+fi
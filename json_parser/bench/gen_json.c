@@ -0,0 +1,190 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/********************************************************************************
+ * generates a reproducible JSON benchmark document, the same kind, size, and
+ * seed always produce the same bytes. Every document is a top level array of
+ * elements of the kind, at least size_mb big, except ndjson which is records
+ * one per line (NDJSON / JSON Lines).
+ * usage: gen_json kind size_mb output [seed]
+ * kinds: records, numbers, strings, text, deep, wide, ndjson
+ ********************************************************************************/
+
+/*xorshift64*, small and the same everywhere*/
+static uint64_t state;
+
+static uint64_t next_random()
+{
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 0x2545F4914F6CDD1DULL;
+}
+
+static uint32_t below(const uint32_t n)
+{
+    return next_random() % n;
+}
+
+static const char* names[] = {"Ada", "Grace", "Linus", "Ken", "Dennis", "Barbara", "Edsger", "Donald", "Margaret", "Alan"};
+static const char* cities[] = {"New York", "Z\xc3\xbcrich", "S\xc3\xa3o Paulo", "\xe6\x9d\xb1\xe4\xba\xac", "Tel Aviv", "Oslo"};
+static const char* tags[] = {"admin", "beta", "paid", "trial", "staff", "bot", "new", "vip"};
+
+/*text for strings: plain words, escapes, \u escapes (with a surrogate pair), and raw utf-8*/
+static const char* pieces[] = {
+    "lorem", "ipsum", "dolor", "sit", "amet", "\\\"quoted\\\"", "line\\nbreak", "tab\\there", "back\\\\slash",
+    "\\u00e9t\\u00e9", "\\ud83d\\ude00", "caf\xc3\xa9", "\xce\xb1\xce\xbb\xcf\x86\xce\xb1", "\xe6\x97\xa5\xe6\x9c\xac"
+};
+
+/*words for text: ascii, latin, greek, cyrillic, cjk, and emoji, written as raw utf-8 without escapes*/
+static const char* words[] = {
+    "the", "quick", "brown", "fox", "jumps", "over", "lazy", "dog", "na\xc3\xafve", "r\xc3\xa9sum\xc3\xa9",
+    "\xce\xba\xce\xb1\xce\xbb\xce\xb7\xce\xbc\xce\xad\xcf\x81\xce\xb1", "\xd0\xbf\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82",
+    "\xe6\x97\xa5\xe6\x9c\xac\xe8\xaa\x9e", "\xe4\xbd\xa0\xe5\xa5\xbd", "\xf0\x9f\x98\x80", "\xf0\x9f\x9a\x80"
+};
+
+/*a user record with every kind of value and a nested object and array*/
+static int records(FILE* out)
+{
+    int len = fprintf(out, "  {\"id\": %u, \"name\": \"%s %s\", \"email\": \"user%u@example.com\", \"active\": %s, ",
+                      below(1000000000), names[below(10)], names[below(10)], below(100000), below(2) ? "true" : "false");
+    len += fprintf(out, "\"score\": %u.%02u, \"balance\": -%u.%u, \"tags\": [", below(100), below(100), below(100000), below(10));
+    const uint32_t count = below(4);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        len += fprintf(out, "%s\"%s\"", i == 0 ? "" : ", ", tags[below(8)]);
+    }
+    len += fprintf(out, "], \"address\": {\"city\": \"%s\", \"zip\": \"%05u\", \"geo\": [%d.%06u, %d.%06u]}, \"manager\": null}",
+                   cities[below(6)], below(100000), (int)below(180) - 90, below(1000000), (int)below(360) - 180, below(1000000));
+    return len;
+}
+
+/*a row of 16 numbers: integers, decimals, and exponents*/
+static int numbers(FILE* out)
+{
+    int len = fprintf(out, "  [");
+    for (int i = 0; i < 16; i++)
+    {
+        const char* separator = i == 0 ? "" : ", ";
+        switch (below(4))
+        {
+            case 0: len += fprintf(out, "%s%d", separator, (int)(next_random() >> 33) - (1 << 30)); break;
+            case 1: len += fprintf(out, "%s%u.%u", separator, below(100000), below(1000000000)); break;
+            case 2: len += fprintf(out, "%s-%u.%ue%d", separator, below(10), below(100000), (int)below(600) - 300); break;
+            default: len += fprintf(out, "%s%llu", separator, (unsigned long long)(next_random() >> 1)); break;
+        }
+    }
+    return len + fprintf(out, "]");
+}
+
+/*a string of 4 to 64 pieces*/
+static int strings(FILE* out)
+{
+    int len = fprintf(out, "  \"");
+    const uint32_t count = 4 + below(61);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        len += fprintf(out, "%s%s", i == 0 ? "" : " ", pieces[below(sizeof(pieces) / sizeof(pieces[0]))]);
+    }
+    return len + fprintf(out, "\"");
+}
+
+/*a paragraph of 16 to 256 words without escapes, every string is a view of the document when it is parsed*/
+static int text(FILE* out)
+{
+    int len = fprintf(out, "  \"");
+    const uint32_t count = 16 + below(241);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        len += fprintf(out, "%s%s", i == 0 ? "" : " ", words[below(sizeof(words) / sizeof(words[0]))]);
+    }
+    return len + fprintf(out, "\"");
+}
+
+/*objects and arrays nested 64 to 512 deep, in turns, with a number at the bottom (well within the parser's max depth)*/
+static int deep(FILE* out)
+{
+    const uint32_t depth = 64 + below(449);
+    int len = fprintf(out, "  ");
+    for (uint32_t i = 0; i < depth; i++)
+    {
+        len += i % 2 == 0 ? fprintf(out, "{\"%s\": ", tags[below(8)]) : fprintf(out, "[");
+    }
+    len += fprintf(out, "%u", below(1000000));
+    for (uint32_t i = depth; i > 0; i--)
+    {
+        len += fprintf(out, (i - 1) % 2 == 0 ? "}" : "]");
+    }
+    return len;
+}
+
+/*a flat object of 256 to 1024 short members, integers, booleans, and small strings*/
+static int wide(FILE* out)
+{
+    int len = fprintf(out, "  {");
+    const uint32_t count = 256 + below(769);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const char* separator = i == 0 ? "" : ", ";
+        switch (below(3))
+        {
+            case 0: len += fprintf(out, "%s\"f%u\": %u", separator, i, below(100000)); break;
+            case 1: len += fprintf(out, "%s\"f%u\": %s", separator, i, below(2) ? "true" : "false"); break;
+            default: len += fprintf(out, "%s\"f%u\": \"%s\"", separator, i, tags[below(8)]); break;
+        }
+    }
+    return len + fprintf(out, "}");
+}
+
+typedef int (*Generator)(FILE* out);
+
+static Generator find_generator(const char* kind)
+{
+    if (strcmp(kind, "records") == 0) { return records; }
+    if (strcmp(kind, "numbers") == 0) { return numbers; }
+    if (strcmp(kind, "strings") == 0) { return strings; }
+    if (strcmp(kind, "text") == 0) { return text; }
+    if (strcmp(kind, "deep") == 0) { return deep; }
+    if (strcmp(kind, "wide") == 0) { return wide; }
+    if (strcmp(kind, "ndjson") == 0) { return records; }
+    return NULL;
+}
+
+int main(const int argc, const char* argv[])
+{
+    if (argc < 4 || argc > 5)
+    {
+        fprintf(stderr, "usage: gen_json kind size_mb output [seed]\n");
+        return 1;
+    }
+    const Generator generate = find_generator(argv[1]);
+    if (generate == NULL)
+    {
+        fprintf(stderr, "unknown kind [%s]\n", argv[1]);
+        return 1;
+    }
+    const uint64_t size = strtoull(argv[2], NULL, 10) << 20;
+    state = argc == 5 ? strtoull(argv[4], NULL, 10) : 0x9E3779B97F4A7C15ULL;
+    if (state == 0) { state = 1; }
+
+    FILE* out = fopen(argv[3], "wb");
+    if (out == NULL)
+    {
+        fprintf(stderr, "[%s] Could not open file.\n", argv[3]);
+        return 1;
+    }
+    const bool lines = strcmp(argv[1], "ndjson") == 0;
+    uint64_t written = fprintf(out, lines ? "" : "[\n");
+    written += generate(out);
+    while (written < size)
+    {
+        written += fprintf(out, lines ? "\n" : ",\n");
+        written += generate(out);
+    }
+    fprintf(out, lines ? "\n" : "\n]\n");
+    fclose(out);
+    return 0;
+}
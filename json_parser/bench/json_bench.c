@@ -0,0 +1,417 @@
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "json_index.h"
+#include "json_lazy.h"
+#include "json_ndjson.h"
+#include "json_parser.h"
+#include "json_stream.h"
+#include "json_tape.h"
+
+#define STREAM_CHUNK (1 << 16)
+
+/********************************************************************************
+ * times the parser over JSON files and prints the throughput of each mode.
+ * usage: json_bench [-r runs] [-t threads[,threads]...] [-p pointer[,pointer]...] mode[,mode]... file...
+ * modes: validate (parse), dom (parse_document and free_document), sax
+ * (parse_sax with a handler that counts every event), stream
+ * (the push parser fed 64 KiB chunks), index (the structural index alone, with
+ * the kernel picked for the cpu or CCJP_KERNEL), ndjson (parse_ndjson validating
+ * a file with a record per line), ndjson-dom (parse_ndjson into documents),
+ * tokens (scan_token alone up to the end or the first error, its throughput is
+ * also printed in millions of tokens per second), tape (tokenize onto a token
+ * tape), tape-dom (parse_tape_document from a tape filled before the runs),
+ * tape-skip (every value of the top level object or array skipped on a tape
+ * filled before the runs), lazy (the values at the JSON Pointers of -p read
+ * with the lazy parser, which only reads the document up to each of them),
+ * pointer-dom (the same values from a document parsed with parse_document)
+ * Each file is read into memory once, every mode runs it runs times and the
+ * fastest run is reported.
+ * With -t every mode is also run on that many threads at once, each thread
+ * parses the whole file with its own parser, and the throughput is the total of
+ * all the threads. Each thread's result is checked against the single threaded
+ * one, a difference is reported as a MISMATCH. The ndjson modes split a single
+ * file across that many threads instead, so their throughput is how
+ * parse_ndjson scales.
+ * The pointers of -p are "/0" when there is no -p, a run of the pointer modes
+ * is valid when every one of them is found.
+ ********************************************************************************/
+
+typedef bool (*BenchMode)(Parser *parser, TokenTape *tape, const char *source, const size_t len, const int threads);
+
+static bool run_validate(Parser *parser, TokenTape *tape, const char *source, const size_t len, const int threads)
+{
+    return parse(parser, source, len);
+}
+
+static bool run_dom(Parser *parser, TokenTape *tape, const char *source, const size_t len, const int threads)
+{
+    Document *document = parse_document(parser, source, len);
+    free_document(document);
+    return document != NULL;
+}
+
+static bool count_event(void *context)
+{
+    (*(size_t *)context)++;
+    return true;
+}
+
+static bool count_slice(void *context, const char *slice, const size_t len)
+{
+    (*(size_t *)context)++;
+    return true;
+}
+
+static bool count_boolean(void *context, const bool value)
+{
+    (*(size_t *)context)++;
+    return true;
+}
+
+static bool run_sax(Parser *parser, TokenTape *tape, const char *source, const size_t len, const int threads)
+{
+    const SaxHandler handler = {count_event, count_event, count_event, count_event, count_slice, count_slice, count_slice,
+                                count_boolean, count_event};
+    size_t events = 0;
+    return parse_sax(parser, source, len, &handler, &events);
+}
+
+static bool run_stream(Parser *parser, TokenTape *tape, const char *source, const size_t len, const int threads)
+{
+    StreamParser stream;
+    init_stream_parser(&stream, NULL, NULL);
+    bool valid = true;
+    for (size_t offset = 0; valid && offset < len; offset += STREAM_CHUNK)
+    {
+        valid = stream_feed(&stream, source + offset, len - offset < STREAM_CHUNK ? len - offset : STREAM_CHUNK);
+    }
+    valid = valid && stream_finish(&stream);
+    free_stream_parser(&stream);
+    return valid;
+}
+
+static bool run_index(Parser *parser, TokenTape *tape, const char *source, const size_t len, const int threads)
+{
+    StructuralIndex *index = &parser->scanner.index;
+    init_index(index, source, len);
+    while (next_window(index)) {}
+    return true;
+}
+
+static bool run_tokens(Parser *parser, TokenTape *tape, const char *source, const size_t len, const int threads)
+{
+    Scanner *scanner = &parser->scanner;
+    init_scanner(scanner, source, len);
+    Token token;
+    do { token = scan_token(scanner); } while (token.type != TOKEN_EOF && token.type != TOKEN_ERROR);
+    return token.type == TOKEN_EOF;
+}
+
+/*the tokens run_tokens scans in the document*/
+static size_t count_tokens(const char *source, const size_t len)
+{
+    Scanner scanner;
+    init_scanner(&scanner, source, len);
+    size_t count = 0;
+    Token token;
+    do
+    {
+        token = scan_token(&scanner);
+        count++;
+    } while (token.type != TOKEN_EOF && token.type != TOKEN_ERROR);
+    return count;
+}
+
+static bool run_tape(Parser *parser, TokenTape *tape, const char *source, const size_t len, const int threads)
+{
+    return tokenize(tape, source, len) && tape->error == NULL;
+}
+
+static bool run_tape_dom(Parser *parser, TokenTape *tape, const char *source, const size_t len, const int threads)
+{
+    Document *document = parse_tape_document(parser, tape);
+    free_document(document);
+    return document != NULL;
+}
+
+/*goes from value to value of the top level object or array without looking inside them*/
+static bool run_tape_skip(Parser *parser, TokenTape *tape, const char *source, const size_t len, const int threads)
+{
+    const TokenType type = tape_type(tape, 0);
+    if (type != TOKEN_BEGIN_OBJECT && type != TOKEN_BEGIN_ARRAY) { return false; }
+    const size_t end = tape_skip(tape, 0) - 1;
+    size_t values = 0;
+    for (size_t entry = 1; entry < end; entry++)
+    {
+        if (type == TOKEN_BEGIN_OBJECT) { entry += 2; } // the key and ':'
+        if (entry >= end) { return false; }
+        entry = tape_skip(tape, entry); // on the ',' or the end
+        values++;
+    }
+    return tape_type(tape, end) != TOKEN_EOF && values > 0;
+}
+
+/*the JSON Pointers of -p, the pointer modes look up each of them in every run*/
+static const char *pointers = "/0";
+
+/*the length of the next pointer in the list, it can't have a ',' in it*/
+static size_t pointer_len(const char *pointer)
+{
+    return strcspn(pointer, ",");
+}
+
+static bool run_lazy(Parser *parser, TokenTape *tape, const char *source, const size_t len, const int threads)
+{
+    LazyParser lazy;
+    init_lazy_parser(&lazy);
+    bool found = lazy_start(&lazy, source, len);
+    for (const char *pointer = pointers; found && *pointer != '\0';)
+    {
+        const size_t pointer_length = pointer_len(pointer);
+        LazyValue value;
+        found = lazy_pointer(&lazy, pointer, pointer_length) && lazy_value(&lazy, &value);
+        pointer += pointer_length;
+        if (*pointer == ',') { pointer++; }
+    }
+    free_lazy_parser(&lazy);
+    return found;
+}
+
+static bool run_pointer_dom(Parser *parser, TokenTape *tape, const char *source, const size_t len, const int threads)
+{
+    Document *document = parse_document(parser, source, len);
+    bool found = document != NULL;
+    for (const char *pointer = pointers; found && *pointer != '\0';)
+    {
+        const size_t pointer_length = pointer_len(pointer);
+        found = value_at_pointer(&document->root, pointer, pointer_length) != NULL;
+        pointer += pointer_length;
+        if (*pointer == ',') { pointer++; }
+    }
+    free_document(document);
+    return found;
+}
+
+static bool run_ndjson(Parser *parser, TokenTape *tape, const char *source, const size_t len, const int threads)
+{
+    NdjsonResult result;
+    const bool valid = parse_ndjson(source, len, threads, NULL, NULL, &result);
+    free_ndjson_result(&result);
+    return valid;
+}
+
+static void drop_record(void *context, const size_t offset, Document *document)
+{
+    free_document(document);
+}
+
+static bool run_ndjson_dom(Parser *parser, TokenTape *tape, const char *source, const size_t len, const int threads)
+{
+    NdjsonResult result;
+    const bool valid = parse_ndjson(source, len, threads, drop_record, NULL, &result);
+    free_ndjson_result(&result);
+    return valid;
+}
+
+/********************************************************************************
+ * a mode that splits is run once with all the threads instead of once per
+ * thread, one that counts tokens prints tokens/s too, and a tokenized one gets
+ * a tape with the document on it, which is filled before the runs.
+ ********************************************************************************/
+typedef struct
+{
+    const char *name;
+    BenchMode run;
+    bool splits;
+    bool counts_tokens;
+    bool tokenized;
+} Mode;
+
+static const Mode modes[] = {
+    {"validate", run_validate, false, false, false},
+    {"dom", run_dom, false, false, false},
+    {"sax", run_sax, false, false, false},
+    {"stream", run_stream, false, false, false},
+    {"index", run_index, false, false, false},
+    {"tokens", run_tokens, false, true, false},
+    {"tape", run_tape, false, true, false},
+    {"tape-dom", run_tape_dom, false, false, true},
+    {"tape-skip", run_tape_skip, false, false, true},
+    {"lazy", run_lazy, false, false, false},
+    {"pointer-dom", run_pointer_dom, false, false, false},
+    {"ndjson", run_ndjson, true, false, false},
+    {"ndjson-dom", run_ndjson_dom, true, false, false},
+};
+
+static const Mode *find_mode(const char *name, const size_t len)
+{
+    for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); i++)
+    {
+        if (strlen(modes[i].name) == len && memcmp(modes[i].name, name, len) == 0) { return &modes[i]; }
+    }
+    return NULL;
+}
+
+static char *read_file(const char *name, size_t *len)
+{
+    FILE *file = fopen(name, "rb");
+    if (file == NULL)
+    {
+        fprintf(stderr, "[%s] Could not open file.\n", name);
+        return NULL;
+    }
+    fseek(file, 0L, SEEK_END);
+    *len = ftell(file);
+    rewind(file);
+    char *buffer = (char *)malloc(*len + 1);
+    if (buffer == NULL || fread(buffer, 1, *len, file) != *len)
+    {
+        fprintf(stderr, "[%s] Could not read file.\n", name);
+        free(buffer);
+        fclose(file);
+        return NULL;
+    }
+    fclose(file);
+    buffer[*len] = '\0';
+    return buffer;
+}
+
+static double now()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+/*one thread of a run, it owns its parser*/
+typedef struct
+{
+    const Mode *mode;
+    Parser parser;
+    TokenTape tape;
+    const char *source;
+    size_t len;
+    int threads;
+    bool valid;
+} Worker;
+
+static void *run_worker(void *arg)
+{
+    Worker *worker = (Worker *)arg;
+    worker->valid = worker->mode->run(&worker->parser, &worker->tape, worker->source, worker->len, worker->threads);
+    return NULL;
+}
+
+/*runs the mode on every worker at once and returns the seconds until the last one is done*/
+static double run_threads(Worker *workers, const int threads)
+{
+    pthread_t ids[threads];
+    const double start = now();
+    for (int i = 1; i < threads; i++) { pthread_create(&ids[i], NULL, run_worker, &workers[i]); }
+    run_worker(&workers[0]);
+    for (int i = 1; i < threads; i++) { pthread_join(ids[i], NULL); }
+    return now() - start;
+}
+
+static void bench(const Mode *mode, const char *name, const char *source, const size_t len, const int runs, const int threads,
+                  const bool expected)
+{
+    const int count = mode->splits ? 1 : threads;
+    Worker *workers = (Worker *)malloc(count * sizeof(Worker));
+    if (workers == NULL) { return; }
+    for (int i = 0; i < count; i++)
+    {
+        workers[i].mode = mode;
+        workers[i].source = source;
+        workers[i].len = len;
+        workers[i].threads = threads;
+        init_parser(&workers[i].parser);
+        init_tape(&workers[i].tape);
+        if (mode->tokenized) { tokenize(&workers[i].tape, source, len); }
+    }
+
+    double best = 0;
+    bool mismatch = false;
+    for (int run = 0; run < runs; run++)
+    {
+        const double seconds = run_threads(workers, count);
+        if (run == 0 || seconds < best) { best = seconds; }
+        for (int i = 0; i < count; i++) { mismatch |= workers[i].valid != expected; }
+    }
+    const double total = (double)len * count;
+    printf("%-11s %-32s %7d %9.2f %9.4f %9.1f", mode->name, name, threads, total / 1e6, best, total / 1e6 / best);
+    if (mode->counts_tokens) { printf(" %9.1f Mtok/s", (double)count_tokens(source, len) * count / 1e6 / best); }
+    printf(" %s\n", mismatch ? "MISMATCH" : expected ? "" : "invalid");
+
+    for (int i = 0; i < count; i++)
+    {
+        free_parser(&workers[i].parser);
+        free_tape(&workers[i].tape);
+    }
+    free(workers);
+}
+
+int main(const int argc, char *argv[])
+{
+    int runs = 5;
+    const char *thread_list = "1";
+    int arg = 1;
+    while (arg + 1 < argc && argv[arg][0] == '-')
+    {
+        if (strcmp(argv[arg], "-r") == 0) { runs = atoi(argv[arg + 1]); }
+        else if (strcmp(argv[arg], "-t") == 0) { thread_list = argv[arg + 1]; }
+        else if (strcmp(argv[arg], "-p") == 0) { pointers = argv[arg + 1]; }
+        else { break; }
+        arg += 2;
+    }
+    if (argc - arg < 2 || runs < 1)
+    {
+        fprintf(stderr, "usage: json_bench [-r runs] [-t threads[,threads]...] [-p pointer[,pointer]...] mode[,mode]... file...\n");
+        return 1;
+    }
+    const char *mode_list = argv[arg++];
+
+    printf("%-11s %-32s %7s %9s %9s %9s\n", "mode", "file", "threads", "MB", "seconds", "MB/s");
+    for (; arg < argc; arg++)
+    {
+        size_t len;
+        char *source = read_file(argv[arg], &len);
+        if (source == NULL) { continue; }
+        for (const char *name = mode_list; *name != '\0';)
+        {
+            const size_t name_len = strcspn(name, ",");
+            const Mode *mode = find_mode(name, name_len);
+            if (mode == NULL)
+            {
+                fprintf(stderr, "unknown mode [%.*s]\n", (int)name_len, name);
+                return 1;
+            }
+            // the single threaded result every thread has to match
+            Parser parser;
+            init_parser(&parser);
+            TokenTape tape;
+            init_tape(&tape);
+            if (mode->tokenized) { tokenize(&tape, source, len); }
+            const bool expected = mode->run(&parser, &tape, source, len, 1);
+            free_parser(&parser);
+            free_tape(&tape);
+
+            for (const char *threads = thread_list; *threads != '\0';)
+            {
+                const int count = atoi(threads);
+                if (count > 0) { bench(mode, argv[arg], source, len, runs, count, expected); }
+                threads += strcspn(threads, ",");
+                if (*threads == ',') { threads++; }
+            }
+            name += name_len;
+            if (*name == ',') { name++; }
+        }
+        free(source);
+    }
+    return 0;
+}
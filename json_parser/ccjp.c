@@ -1,70 +1,233 @@
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
+#include "json_lazy.h"
+#include "json_ndjson.h"
 #include "json_scanner.h"
+#include "json_stream.h"
+#include "json_tape.h"
 
-static char* read_doc(char *source)
+#define CHUNK_SIZE (1 << 16)
+
+/*a document in memory, mapped from its file when it can be*/
+typedef struct
 {
-    FILE* file = fopen(source, "r");
-    if (file == NULL)
+    char *data;
+    size_t len;
+    bool mapped;
+} Doc;
+
+/*reads what is left of the file into a buffer that doubles as it fills*/
+static bool read_doc(const int fd, const char *source, Doc *doc)
+{
+    size_t capacity = CHUNK_SIZE;
+    doc->data = (char *)malloc(capacity);
+    doc->len = 0;
+    doc->mapped = false;
+    for (;;)
+    {
+        if (doc->data == NULL)
+        {
+            fprintf(stderr, "[%s] Not enough memory to read file.\n", source);
+            return false;
+        }
+        const ssize_t got = read(fd, doc->data + doc->len, capacity - doc->len);
+        if (got == 0) { return true; }
+        if (got < 0)
+        {
+            fprintf(stderr, "[%s] Could not read file.\n", source);
+            free(doc->data);
+            return false;
+        }
+        doc->len += got;
+        if (doc->len == capacity)
+        {
+            capacity *= 2;
+            char *data = (char *)realloc(doc->data, capacity);
+            if (data == NULL) { free(doc->data); }
+            doc->data = data;
+        }
+    }
+}
+
+/********************************************************************************
+ * maps the file read only instead of copying it, the scanner starts on the
+ * first page right away and the kernel reads ahead of it. The document doesn't
+ * need a NUL at its end, the scanner stops at its length. A file that can't be
+ * mapped (a pipe, - for stdin, an empty file) is read into a buffer instead.
+ ********************************************************************************/
+static bool open_doc(const char *source, Doc *doc)
+{
+    const int fd = strcmp(source, "-") == 0 ? STDIN_FILENO : open(source, O_RDONLY);
+    if (fd < 0)
     {
         fprintf(stderr, "[%s] Could not open file.\n", source);
-        return NULL;
+        return false;
+    }
+
+    struct stat st;
+    bool opened = false;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+    {
+        void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED)
+        {
+            madvise(data, st.st_size, MADV_SEQUENTIAL);
+            doc->data = (char *)data;
+            doc->len = st.st_size;
+            doc->mapped = true;
+            opened = true;
+        }
     }
+    if (!opened) { opened = read_doc(fd, source, doc); }
+    if (fd != STDIN_FILENO) { close(fd); }
+    return opened;
+}
+
+static void close_doc(Doc *doc)
+{
+    if (doc->mapped) { munmap(doc->data, doc->len); }
+    else { free(doc->data); }
+}
 
-    fseek(file, 0L, SEEK_END);
-    size_t filesize = ftell(file);
-    rewind(file);
+static void print_token(const TokenType type);
 
-    char *buffer = (char *)malloc(filesize + 1);
-    if (buffer == NULL)
+static void print_stream_token(void *context, const Token token)
+{
+    (void)context;
+    print_token(token.type);
+}
+
+/********************************************************************************
+ * prints the tokens of the document while it is read a chunk at a time, so only
+ * a chunk of it is ever in memory. The file can be - for stdin. Stops at the
+ * first error and reports it with its line.
+ ********************************************************************************/
+static int stream_doc(const char *source)
+{
+    FILE *file = strcmp(source, "-") == 0 ? stdin : fopen(source, "rb");
+    if (file == NULL)
     {
-        fprintf(stderr, "[%s] Not enough memory to read file.", source);
-        return NULL;
+        fprintf(stderr, "[%s] Could not open file.\n", source);
+        return 1;
     }
 
-    size_t bytesread = fread(buffer, sizeof(char), filesize, file);
-    if (bytesread != filesize)
+    StreamParser parser;
+    init_stream_parser(&parser, print_stream_token, NULL);
+    static char chunk[CHUNK_SIZE];
+    bool valid = true;
+    size_t len;
+    while (valid && (len = fread(chunk, 1, sizeof(chunk), file)) > 0)
+    {
+        valid = stream_feed(&parser, chunk, len);
+    }
+    if (ferror(file))
     {
-        fprintf(stderr, "[%s] Could not read file.", source);
-        return NULL;
+        fprintf(stderr, "[%s] Could not read file.\n", source);
+        valid = false;
     }
+    else if (valid) { valid = stream_finish(&parser); }
+    if (parser.error != NULL) { fprintf(stderr, "[%s] line %u: %s\n", source, parser.line, parser.error); }
 
-    fclose(file);
-    buffer[filesize] = '\0';
-    return buffer;
+    free_stream_parser(&parser);
+    if (file != stdin) { fclose(file); }
+    return valid ? 0 : 1;
 }
 
-static void print_token(const Token token);
+/********************************************************************************
+ * validates an NDJSON document, a JSON document per line, on threads worker
+ * threads (0 for one per cpu). Prints the invalid records in the order of their
+ * lines and how many records there were.
+ ********************************************************************************/
+static int ndjson_doc(const char *source, const unsigned int threads)
+{
+    Doc doc;
+    if (!open_doc(source, &doc))
+    {
+        // error already reported
+        return 1;
+    }
+    NdjsonResult result;
+    const bool valid = parse_ndjson(doc.data, doc.len, threads, NULL, NULL, &result);
+    for (size_t i = 0; i < result.error_count; i++)
+    {
+        fprintf(stderr, "[%s] line %zu: %s\n", source, result.errors[i].line, result.errors[i].message);
+    }
+    printf("records: %zu invalid: %zu\n", result.records, result.invalid);
+    free_ndjson_result(&result);
+    close_doc(&doc);
+    return valid ? 0 : 1;
+}
+
+/********************************************************************************
+ * prints the value at the JSON Pointer in the document as it is written, only
+ * reading the document up to it. Returns 1 if there is no such value, and
+ * reports an error on the way to it with its line.
+ ********************************************************************************/
+static int query_doc(const char *pointer, const char *source)
+{
+    Doc doc;
+    if (!open_doc(source, &doc))
+    {
+        // error already reported
+        return 1;
+    }
+    LazyParser lazy;
+    init_lazy_parser(&lazy);
+    LazyValue value;
+    bool found = lazy_start(&lazy, doc.data, doc.len) && lazy_pointer(&lazy, pointer, strlen(pointer)) && lazy_value(&lazy, &value);
+    if (found) { printf("%.*s\n", (int)value.len, value.text); }
+    else if (lazy.error != NULL && lazy.error_line == 0) { fprintf(stderr, "[%s] %s: %s\n", source, pointer, lazy.error); }
+    else if (lazy.error != NULL) { fprintf(stderr, "[%s] line %u: %s\n", source, lazy.error_line, lazy.error); }
+    else { fprintf(stderr, "[%s] %s: Not found.\n", source, pointer); }
+    free_lazy_parser(&lazy);
+    close_doc(&doc);
+    return found ? 0 : 1;
+}
 
 int main(const int argc, char *argv[])
 {
+    if (argc == 4 && strcmp(argv[1], "--query") == 0) { return query_doc(argv[2], argv[3]); }
+    if (argc == 3 && strcmp(argv[1], "--stream") == 0) { return stream_doc(argv[2]); }
+    if (argc == 3 && strcmp(argv[1], "--ndjson") == 0) { return ndjson_doc(argv[2], 0); }
+    if (argc == 5 && strcmp(argv[1], "--ndjson") == 0 && strcmp(argv[2], "-j") == 0) { return ndjson_doc(argv[4], atoi(argv[3])); }
     if (argc != 2)
     {
         fprintf(stderr, "No test file entered.\n");
         return 1;
     }
-     char *source = read_doc(argv[1]);
-     if (source == NULL)
-     {
+    Doc doc;
+    if (!open_doc(argv[1], &doc))
+    {
         // error already reported
         return 1;
-     }
+    }
 
-    init_scanner(source);
-    Token token = scan_token();
-    while (token.type != TOKEN_EOF)
+    // the whole document is tokenized onto a tape first, then printed from it
+    TokenTape tape;
+    init_tape(&tape);
+    if (!tokenize(&tape, doc.data, doc.len))
     {
-        print_token(token);
-        token = scan_token();
+        fprintf(stderr, "[%s] Not enough memory to tokenize file.\n", argv[1]);
+        free_tape(&tape);
+        close_doc(&doc);
+        return 1;
     }
-    print_token(token);
+    for (size_t entry = 0; entry < tape.count; entry++) { print_token(tape_type(&tape, entry)); }
+    if (tape.error != NULL) { fprintf(stderr, "[%s] line %u: %s\n", argv[1], tape_line(&tape, tape.error_entry), tape.error); }
+    free_tape(&tape);
+    close_doc(&doc);
     return 0;
 }
 
-static void print_full_token(const Token token)
+static void print_full_token(const TokenType type)
 {
-    switch (token.type)
+    switch (type)
     {
         case TOKEN_STRING: printf("token: [string]"); break;
         case TOKEN_NUMBER: printf("token: [number]"); break;
@@ -77,9 +240,9 @@ static void print_full_token(const Token token)
     printf("\n");
 }
 
-static void print_token(const Token token)
+static void print_token(const TokenType type)
 {
-    switch (token.type)
+    switch (type)
     {
         case TOKEN_BEGIN_OBJECT: printf("token: [begin-obj]\n"); return;
         case TOKEN_END_OBJECT: printf("token: [end-obj]\n"); return;
@@ -95,7 +258,7 @@ static void print_token(const Token token)
         case TOKEN_FALSE:
         case TOKEN_NULL:
         case TOKEN_ERROR:
-            print_full_token(token);
+            print_full_token(type);
             return;
     }
 }
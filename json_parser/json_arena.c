@@ -0,0 +1,61 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "json_arena.h"
+
+#define ARENA_MIN_BLOCK (64u << 10)
+#define ARENA_ALIGN 8
+
+void init_arena(Arena *arena, const size_t size_hint)
+{
+    arena->head = NULL;
+    arena->next_size = size_hint < ARENA_MIN_BLOCK ? ARENA_MIN_BLOCK : size_hint;
+}
+
+/*starts a new block big enough for size, the blocks double so there are only log(n) of them*/
+static ArenaBlock *new_block(Arena *arena, const size_t size)
+{
+    size_t block_size = arena->next_size;
+    while (block_size < size) { block_size *= 2; }
+    ArenaBlock *block = (ArenaBlock *)malloc(sizeof(ArenaBlock) + block_size);
+    if (block == NULL) { return NULL; }
+    block->next = arena->head;
+    block->size = block_size;
+    block->used = 0;
+    arena->head = block;
+    arena->next_size = block_size * 2;
+    return block;
+}
+
+void *arena_alloc(Arena *arena, const size_t size)
+{
+    const size_t aligned = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    ArenaBlock *block = arena->head;
+    if (block == NULL || block->size - block->used < aligned)
+    {
+        block = new_block(arena, aligned);
+        if (block == NULL) { return NULL; }
+    }
+    void *memory = block->data + block->used;
+    block->used += aligned;
+    return memory;
+}
+
+void *arena_copy(Arena *arena, const void *source, const size_t len)
+{
+    void *memory = arena_alloc(arena, len);
+    if (memory != NULL && len > 0) { memcpy(memory, source, len); }
+    return memory;
+}
+
+void free_arena(Arena *arena)
+{
+    ArenaBlock *block = arena->head;
+    while (block != NULL)
+    {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->head = NULL;
+}
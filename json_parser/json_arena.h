@@ -0,0 +1,38 @@
+#ifndef JSON_ARENA_H
+#define JSON_ARENA_H
+
+#include <stddef.h>
+
+/********************************************************************************
+ * A bump allocator for everything a parsed document owns. Memory is taken from
+ * the current block by moving a pointer, a new block (at least double the size
+ * of the last one) is only malloc'd when the current block is full, and the
+ * whole arena is released in one call. Nothing is freed individually.
+ ********************************************************************************/
+typedef struct ArenaBlock
+{
+    struct ArenaBlock *next;
+    size_t size;
+    size_t used;
+    char data[];
+} ArenaBlock;
+
+typedef struct
+{
+    ArenaBlock *head;
+    size_t next_size;
+} Arena;
+
+/*initializes an empty arena, the first block is size_hint bytes (or a minimum block) when it is first used*/
+void init_arena(Arena *arena, const size_t size_hint);
+
+/*returns size bytes aligned to 8 bytes, or NULL when out of memory*/
+void *arena_alloc(Arena *arena, const size_t size);
+
+/*copies len bytes into the arena*/
+void *arena_copy(Arena *arena, const void *source, const size_t len);
+
+/*frees every block of the arena at once*/
+void free_arena(Arena *arena);
+
+#endif
@@ -0,0 +1,510 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "json_index.h"
+#include "json_utf8.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define INDEX_X86
+#include <immintrin.h>
+#endif
+
+/*the kernels classify 64 bytes at a time, the tail is copied into a block padded with spaces*/
+#define INDEX_BLOCK 64
+
+#define INDEX_INLINE static inline __attribute__((always_inline))
+
+/*bit i of each mask is set if byte i of the block is that kind of character*/
+typedef struct
+{
+    uint64_t quote;
+    uint64_t backslash;
+    uint64_t whitespace;
+    uint64_t structural;
+    uint64_t newline;
+    uint64_t control;
+    uint64_t non_ascii;
+} BlockMasks;
+
+typedef void (*IndexKernel)(StructuralIndex *index, const unsigned char *blocks, const size_t len, const size_t offset);
+
+static const char *kernel_names[INDEX_KERNEL_COUNT] = {"scalar", "sse2", "avx2", "avx512"};
+
+/********************************************************************************
+ * the characters escaped by a backslash. A run of backslashes escapes the
+ * character after it when it is odd, so the runs that start on an even bit
+ * and the runs that start on an odd bit are told apart by adding the run
+ * starts to the backslashes, the carry ripples through each run. A run that
+ * reaches the end of the block escapes the first character of the next one.
+ ********************************************************************************/
+INDEX_INLINE uint64_t find_escaped(uint64_t backslash, uint64_t *next_escaped)
+{
+    const uint64_t even_bits = 0x5555555555555555ULL;
+    backslash &= ~*next_escaped;
+    const uint64_t follows_escape = backslash << 1 | *next_escaped;
+    const uint64_t odd_starts = backslash & ~even_bits & ~follows_escape;
+    uint64_t even_runs;
+    *next_escaped = __builtin_add_overflow(odd_starts, backslash, &even_runs);
+    return (even_bits ^ (even_runs << 1)) & follows_escape;
+}
+
+/*bit i is the xor of bits 0 to i, so every bit from an opening quote up to (not including) its closing quote is set*/
+INDEX_INLINE uint64_t prefix_xor(uint64_t bits)
+{
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+    return bits;
+}
+
+/********************************************************************************
+ * turns the masks of the block at offset in the window into entries, this part is the same for
+ * every kernel. Outside of strings an entry is a structural character, an
+ * opening quote, or the first character of a run of characters that are not
+ * whitespace, structural, or quotes (a number or a keyword).
+ ********************************************************************************/
+INDEX_INLINE void add_block(StructuralIndex *index, const BlockMasks *masks, const uint32_t offset)
+{
+    const uint64_t escaped = find_escaped(masks->backslash, &index->escaped);
+    const uint64_t quote = masks->quote & ~escaped;
+    const uint64_t in_string = prefix_xor(quote) ^ index->in_string;
+    index->in_string = (uint64_t)((int64_t)in_string >> 63);
+
+    const uint64_t scalar = ~(masks->structural | masks->whitespace | quote | in_string);
+    const uint64_t scalar_start = scalar & ~(scalar << 1 | index->scalar);
+    index->scalar = scalar >> 63;
+
+    uint64_t entries = (masks->structural & ~in_string) | (quote & in_string) | scalar_start;
+    const uint64_t newline = masks->newline & ~in_string;
+    index->stops[offset / 64] = masks->quote | masks->backslash | masks->control;
+    index->newlines[offset / 64] = newline;
+    index->block_lines[offset / 64] = index->line;
+    index->line += __builtin_popcountll(newline);
+
+    uint32_t *positions = index->positions + index->count;
+    index->count += __builtin_popcountll(entries);
+    for (; entries != 0; entries &= entries - 1) { *positions++ = offset + __builtin_ctzll(entries); }
+}
+
+/*the number of bytes at the end of the 4 bytes that start a character the next block has to finish*/
+INDEX_INLINE unsigned int utf8_cut(const unsigned char *end)
+{
+    if (end[3] >= 0xc0) { return 1; }
+    if (end[2] >= 0xe0) { return 2; }
+    if (end[1] >= 0xf0) { return 3; }
+    return 0;
+}
+
+/*keeps the end of the block if it cuts a character off*/
+INDEX_INLINE void set_utf8_tail(StructuralIndex *index, const unsigned char *block)
+{
+    const unsigned char *end = block + INDEX_BLOCK - 4;
+    index->utf8_tail = 0;
+    if (utf8_cut(end) != 0) { memcpy(&index->utf8_tail, end, 4); }
+}
+
+/*a block needs a utf-8 check if it has a byte past ascii or finishes a character, and only until the first error*/
+INDEX_INLINE bool needs_utf8_check(const StructuralIndex *index, const BlockMasks *masks)
+{
+    return (masks->non_ascii != 0 || index->utf8_tail != 0) && index->invalid_utf8 == SIZE_MAX;
+}
+
+/********************************************************************************
+ * checks the utf-8 of the block at offset in the window one character at a
+ * time, starting with the character the last block cut off and then jumping
+ * from one byte past ascii to the next with the mask. This is the check of the
+ * kernels without a vectorized one, and it finds where the error is for the
+ * ones that have it.
+ ********************************************************************************/
+static void check_utf8_scalar(StructuralIndex *index, const unsigned char *block, const BlockMasks *masks, const size_t offset)
+{
+    unsigned char bytes[4 + INDEX_BLOCK];
+    memcpy(bytes, &index->utf8_tail, 4);
+    memcpy(bytes + 4, block, INDEX_BLOCK);
+    const unsigned char *end = bytes + sizeof(bytes);
+    uint64_t rest = masks->non_ascii;
+    const unsigned char *c = bytes + 4 - utf8_cut(bytes);
+    if (c == bytes + 4 && rest != 0) { c += __builtin_ctzll(rest); }
+    while (c < end)
+    {
+        unsigned char low, high;
+        const unsigned int len = utf8_lead(*c, &low, &high);
+        if (!utf8_valid_prefix(c, end, len, low, high))
+        {
+            index->invalid_utf8 = index->base + offset + (c - bytes) - 4;
+            return;
+        }
+        c += len;
+        const size_t checked = c - (bytes + 4);
+        rest &= checked < INDEX_BLOCK ? ~0ULL << checked : 0;
+        if (rest == 0) { break; }
+        c = bytes + 4 + __builtin_ctzll(rest);
+    }
+    set_utf8_tail(index, block);
+}
+
+/********************************************************************************
+ * defines a kernel that indexes the blocks of len bytes (a multiple of the
+ * block size) that are at offset in the window with the masks and utf-8 check
+ * functions given. attr is the target of the kernel.
+ ********************************************************************************/
+#define INDEX_KERNEL(name, masks, check_utf8, attr) \
+    attr static void name(StructuralIndex *index, const unsigned char *blocks, const size_t len, const size_t offset) \
+    { \
+        for (size_t i = 0; i < len; i += INDEX_BLOCK) \
+        { \
+            BlockMasks block; \
+            masks(blocks + i, &block); \
+            add_block(index, &block, offset + i); \
+            if (needs_utf8_check(index, &block)) { check_utf8(index, blocks + i, &block, offset + i); } \
+        } \
+    }
+
+/*the reference kernel, every other kernel must build the same masks*/
+INDEX_INLINE void masks_scalar(const unsigned char *block, BlockMasks *masks)
+{
+    memset(masks, 0, sizeof(BlockMasks));
+    for (int i = 0; i < INDEX_BLOCK; i++)
+    {
+        const uint64_t bit = 1ULL << i;
+        if (block[i] < 0x20) { masks->control |= bit; }
+        if (block[i] >= 0x80) { masks->non_ascii |= bit; }
+        switch (block[i])
+        {
+            case '"': masks->quote |= bit; break;
+            case '\\': masks->backslash |= bit; break;
+            case '\n': masks->newline |= bit; // fall through, a newline is also whitespace
+            case ' ':
+            case '\t':
+            case '\r':
+                masks->whitespace |= bit;
+                break;
+            case '{':
+            case '}':
+            case '[':
+            case ']':
+            case ':':
+            case ',':
+                masks->structural |= bit;
+                break;
+        }
+    }
+}
+
+INDEX_KERNEL(index_scalar, masks_scalar, check_utf8_scalar, )
+
+#ifdef INDEX_X86
+
+/********************************************************************************
+ * the tables of the vectorized utf-8 checks, every bit is an error a pair of
+ * bytes can be: the one looked up by the high nibble of the first byte, the
+ * one by its low nibble, and the one by the high nibble of the second byte.
+ ********************************************************************************/
+#define UTF8_TOO_SHORT (1 << 0)      // a lead followed by a lead or ascii
+#define UTF8_TOO_LONG (1 << 1)       // ascii followed by a continuation
+#define UTF8_OVERLONG_3 (1 << 2)     // 11100000 100_____
+#define UTF8_TOO_LARGE (1 << 3)      // 11110100 1001____ and 11110100 101_____
+#define UTF8_SURROGATE (1 << 4)      // 11101101 101_____
+#define UTF8_OVERLONG_2 (1 << 5)     // 1100000_ 10______
+#define UTF8_TOO_LARGE_1000 (1 << 6) // 11110101 1000____ and higher leads
+#define UTF8_OVERLONG_4 (1 << 6)     // 11110000 1000____
+#define UTF8_TWO_CONTS (1 << 7)      // a continuation followed by a continuation
+#define UTF8_CARRY (UTF8_TOO_SHORT | UTF8_TOO_LONG | UTF8_TWO_CONTS)
+
+static const unsigned char utf8_byte_1_high[16] = {
+    // 0_______ ascii
+    UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+    // 10______ continuation
+    UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS,
+    UTF8_TOO_SHORT | UTF8_OVERLONG_2, // 1100____
+    UTF8_TOO_SHORT, // 1101____
+    UTF8_TOO_SHORT | UTF8_OVERLONG_3 | UTF8_SURROGATE, // 1110____
+    UTF8_TOO_SHORT | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4 // 1111____
+};
+
+static const unsigned char utf8_byte_1_low[16] = {
+    UTF8_CARRY | UTF8_OVERLONG_3 | UTF8_OVERLONG_2 | UTF8_OVERLONG_4, // ____0000
+    UTF8_CARRY | UTF8_OVERLONG_2, // ____0001
+    UTF8_CARRY, UTF8_CARRY, // ____001_
+    UTF8_CARRY | UTF8_TOO_LARGE, // ____0100
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000, // ____0101
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000, UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000, // ____011_
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000, UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000, // ____1___
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000, UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_SURROGATE, // ____1101
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000, UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000
+};
+
+static const unsigned char utf8_byte_2_high[16] = {
+    // ________ 0_______ ascii
+    UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+    UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4, // ________ 1000____
+    UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE, // ________ 1001____
+    UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE | UTF8_TOO_LARGE, // ________ 101_____
+    UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE | UTF8_TOO_LARGE,
+    // ________ 11______ a lead
+    UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT
+};
+
+/*the masks of 16 bytes, shifted into place in the block*/
+INDEX_INLINE void masks_sse2_part(const unsigned char *p, BlockMasks *masks, const int shift)
+{
+    const __m128i v = _mm_loadu_si128((const __m128i *)p);
+#define EQ(c) _mm_cmpeq_epi8(v, _mm_set1_epi8(c))
+    const __m128i newline = EQ('\n');
+    const __m128i whitespace = _mm_or_si128(_mm_or_si128(newline, EQ(' ')), _mm_or_si128(EQ('\t'), EQ('\r')));
+    const __m128i structural = _mm_or_si128(_mm_or_si128(_mm_or_si128(EQ('{'), EQ('}')), _mm_or_si128(EQ('['), EQ(']'))),
+                                            _mm_or_si128(EQ(':'), EQ(',')));
+    masks->quote |= (uint64_t)(uint16_t)_mm_movemask_epi8(EQ('"')) << shift;
+    masks->backslash |= (uint64_t)(uint16_t)_mm_movemask_epi8(EQ('\\')) << shift;
+#undef EQ
+    masks->whitespace |= (uint64_t)(uint16_t)_mm_movemask_epi8(whitespace) << shift;
+    masks->structural |= (uint64_t)(uint16_t)_mm_movemask_epi8(structural) << shift;
+    masks->newline |= (uint64_t)(uint16_t)_mm_movemask_epi8(newline) << shift;
+    const __m128i control = _mm_cmpeq_epi8(_mm_min_epu8(v, _mm_set1_epi8(0x1f)), v); // unsigned v <= 0x1f
+    masks->control |= (uint64_t)(uint16_t)_mm_movemask_epi8(control) << shift;
+    masks->non_ascii |= (uint64_t)(uint16_t)_mm_movemask_epi8(v) << shift;
+}
+
+INDEX_INLINE void masks_sse2(const unsigned char *block, BlockMasks *masks)
+{
+    memset(masks, 0, sizeof(BlockMasks));
+    for (int i = 0; i < INDEX_BLOCK; i += 16) { masks_sse2_part(block + i, masks, i); }
+}
+
+INDEX_KERNEL(index_sse2, masks_sse2, check_utf8_scalar, )
+
+#define INDEX_AVX2 __attribute__((target("avx2,popcnt,bmi")))
+
+INDEX_AVX2 INDEX_INLINE void masks_avx2_part(const unsigned char *p, BlockMasks *masks, const int shift)
+{
+    const __m256i v = _mm256_loadu_si256((const __m256i *)p);
+#define EQ(c) _mm256_cmpeq_epi8(v, _mm256_set1_epi8(c))
+    const __m256i newline = EQ('\n');
+    const __m256i whitespace = _mm256_or_si256(_mm256_or_si256(newline, EQ(' ')), _mm256_or_si256(EQ('\t'), EQ('\r')));
+    const __m256i structural = _mm256_or_si256(_mm256_or_si256(_mm256_or_si256(EQ('{'), EQ('}')),
+                                                               _mm256_or_si256(EQ('['), EQ(']'))),
+                                               _mm256_or_si256(EQ(':'), EQ(',')));
+    masks->quote |= (uint64_t)(uint32_t)_mm256_movemask_epi8(EQ('"')) << shift;
+    masks->backslash |= (uint64_t)(uint32_t)_mm256_movemask_epi8(EQ('\\')) << shift;
+#undef EQ
+    masks->whitespace |= (uint64_t)(uint32_t)_mm256_movemask_epi8(whitespace) << shift;
+    masks->structural |= (uint64_t)(uint32_t)_mm256_movemask_epi8(structural) << shift;
+    masks->newline |= (uint64_t)(uint32_t)_mm256_movemask_epi8(newline) << shift;
+    const __m256i control = _mm256_cmpeq_epi8(_mm256_min_epu8(v, _mm256_set1_epi8(0x1f)), v);
+    masks->control |= (uint64_t)(uint32_t)_mm256_movemask_epi8(control) << shift;
+    masks->non_ascii |= (uint64_t)(uint32_t)_mm256_movemask_epi8(v) << shift;
+}
+
+INDEX_AVX2 INDEX_INLINE void masks_avx2(const unsigned char *block, BlockMasks *masks)
+{
+    memset(masks, 0, sizeof(BlockMasks));
+    masks_avx2_part(block, masks, 0);
+    masks_avx2_part(block + 32, masks, 32);
+}
+
+/********************************************************************************
+ * the utf-8 errors of 32 bytes, 0 if they are valid, with the lookup algorithm
+ * of Keiser and Lemire: every error shows in a pair of bytes, so the high
+ * nibble of the byte before, its low nibble, and the high nibble of the byte
+ * each look up the errors they could be part of, and the pair is an error if
+ * all three agree. A continuation byte that the lead two or three bytes before
+ * asks for is the one pair that is not an error, the must_be_continuation
+ * bit cancels the two continuations error out.
+ * prev_input holds the 32 bytes before input.
+ ********************************************************************************/
+INDEX_AVX2 INDEX_INLINE __m256i utf8_errors_avx2(const __m256i input, const __m256i prev_input)
+{
+    const __m256i before = _mm256_permute2x128_si256(prev_input, input, 0x21);
+    const __m256i prev1 = _mm256_alignr_epi8(input, before, 15);
+    const __m256i prev2 = _mm256_alignr_epi8(input, before, 14);
+    const __m256i prev3 = _mm256_alignr_epi8(input, before, 13);
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+#define TABLE(table) _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)table))
+    const __m256i byte_1_high = _mm256_shuffle_epi8(TABLE(utf8_byte_1_high), _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble));
+    const __m256i byte_1_low = _mm256_shuffle_epi8(TABLE(utf8_byte_1_low), _mm256_and_si256(prev1, nibble));
+    const __m256i byte_2_high = _mm256_shuffle_epi8(TABLE(utf8_byte_2_high), _mm256_and_si256(_mm256_srli_epi16(input, 4), nibble));
+#undef TABLE
+    const __m256i special = _mm256_and_si256(_mm256_and_si256(byte_1_high, byte_1_low), byte_2_high);
+    const __m256i third = _mm256_subs_epu8(prev2, _mm256_set1_epi8(0xe0 - 0x80)); // only 111_____ leads are >= 0x80
+    const __m256i fourth = _mm256_subs_epu8(prev3, _mm256_set1_epi8(0xf0 - 0x80)); // only 1111____ leads are >= 0x80
+    const __m256i must_be_continuation = _mm256_and_si256(_mm256_or_si256(third, fourth), _mm256_set1_epi8(UTF8_TWO_CONTS));
+    return _mm256_xor_si256(must_be_continuation, special);
+}
+
+/*checks the utf-8 of the block 32 bytes at a time, the scalar check finds where an error is*/
+INDEX_AVX2 INDEX_INLINE void check_utf8_avx2(StructuralIndex *index, const unsigned char *block, const BlockMasks *masks,
+                                             const size_t offset)
+{
+    const __m256i tail = _mm256_insert_epi32(_mm256_setzero_si256(), (int)index->utf8_tail, 7);
+    const __m256i first = _mm256_loadu_si256((const __m256i *)block);
+    const __m256i second = _mm256_loadu_si256((const __m256i *)(block + 32));
+    const __m256i errors = _mm256_or_si256(utf8_errors_avx2(first, tail), utf8_errors_avx2(second, first));
+    if (!_mm256_testz_si256(errors, errors))
+    {
+        check_utf8_scalar(index, block, masks, offset);
+        return;
+    }
+    set_utf8_tail(index, block);
+}
+
+INDEX_KERNEL(index_avx2, masks_avx2, check_utf8_avx2, INDEX_AVX2)
+
+#define INDEX_AVX512 __attribute__((target("avx512f,avx512bw,popcnt,bmi")))
+
+INDEX_AVX512 INDEX_INLINE void masks_avx512(const unsigned char *block, BlockMasks *masks)
+{
+    const __m512i v = _mm512_loadu_si512((const void *)block);
+#define EQ(c) _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8(c))
+    masks->quote = EQ('"');
+    masks->backslash = EQ('\\');
+    masks->newline = EQ('\n');
+    masks->whitespace = masks->newline | EQ(' ') | EQ('\t') | EQ('\r');
+    masks->structural = EQ('{') | EQ('}') | EQ('[') | EQ(']') | EQ(':') | EQ(',');
+#undef EQ
+    masks->control = _mm512_cmplt_epu8_mask(v, _mm512_set1_epi8(0x1f + 1));
+    masks->non_ascii = _mm512_movepi8_mask(v);
+}
+
+/*utf8_errors_avx2 on 64 bytes, each 16 byte lane takes the bytes before it from the lane before*/
+INDEX_AVX512 INDEX_INLINE __m512i utf8_errors_avx512(const __m512i input, const __m512i prev_input)
+{
+    const __m512i before = _mm512_permutex2var_epi64(prev_input, _mm512_set_epi64(13, 12, 11, 10, 9, 8, 7, 6), input);
+    const __m512i prev1 = _mm512_alignr_epi8(input, before, 15);
+    const __m512i prev2 = _mm512_alignr_epi8(input, before, 14);
+    const __m512i prev3 = _mm512_alignr_epi8(input, before, 13);
+    const __m512i nibble = _mm512_set1_epi8(0x0f);
+#define TABLE(table) _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i *)table))
+    const __m512i byte_1_high = _mm512_shuffle_epi8(TABLE(utf8_byte_1_high), _mm512_and_si512(_mm512_srli_epi16(prev1, 4), nibble));
+    const __m512i byte_1_low = _mm512_shuffle_epi8(TABLE(utf8_byte_1_low), _mm512_and_si512(prev1, nibble));
+    const __m512i byte_2_high = _mm512_shuffle_epi8(TABLE(utf8_byte_2_high), _mm512_and_si512(_mm512_srli_epi16(input, 4), nibble));
+#undef TABLE
+    const __m512i special = _mm512_and_si512(_mm512_and_si512(byte_1_high, byte_1_low), byte_2_high);
+    const __m512i third = _mm512_subs_epu8(prev2, _mm512_set1_epi8(0xe0 - 0x80));
+    const __m512i fourth = _mm512_subs_epu8(prev3, _mm512_set1_epi8(0xf0 - 0x80));
+    const __m512i must_be_continuation = _mm512_and_si512(_mm512_or_si512(third, fourth), _mm512_set1_epi8(UTF8_TWO_CONTS));
+    return _mm512_xor_si512(must_be_continuation, special);
+}
+
+INDEX_AVX512 INDEX_INLINE void check_utf8_avx512(StructuralIndex *index, const unsigned char *block, const BlockMasks *masks,
+                                                 const size_t offset)
+{
+    const __m512i tail = _mm512_maskz_set1_epi32(1 << 15, (int)index->utf8_tail);
+    const __m512i errors = utf8_errors_avx512(_mm512_loadu_si512((const void *)block), tail);
+    if (_mm512_test_epi8_mask(errors, errors) != 0)
+    {
+        check_utf8_scalar(index, block, masks, offset);
+        return;
+    }
+    set_utf8_tail(index, block);
+}
+
+INDEX_KERNEL(index_avx512, masks_avx512, check_utf8_avx512, INDEX_AVX512)
+
+#endif
+
+static IndexKernel find_kernel(const IndexKernelType type)
+{
+    switch (type)
+    {
+        case INDEX_KERNEL_SCALAR: return index_scalar;
+#ifdef INDEX_X86
+        case INDEX_KERNEL_SSE2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("sse2") ? index_sse2 : NULL;
+        case INDEX_KERNEL_AVX2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt") && __builtin_cpu_supports("bmi")
+                ? index_avx2 : NULL;
+        case INDEX_KERNEL_AVX512:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("popcnt") && __builtin_cpu_supports("bmi")
+                ? index_avx512 : NULL;
+#endif
+        default: return NULL;
+    }
+}
+
+/*picks the fastest kernel the cpu supports unless CCJP_KERNEL forces one*/
+static IndexKernel select_kernel()
+{
+    const char *forced = getenv("CCJP_KERNEL");
+    if (forced != NULL)
+    {
+        for (int type = 0; type < INDEX_KERNEL_COUNT; type++)
+        {
+            if (strcmp(forced, kernel_names[type]) == 0 && find_kernel(type) != NULL) { return find_kernel(type); }
+        }
+    }
+    for (int type = INDEX_KERNEL_COUNT - 1; type >= 0; type--)
+    {
+        if (find_kernel(type) != NULL) { return find_kernel(type); }
+    }
+    return index_scalar;
+}
+
+/*indexes the next window, the last block of the document is copied into a block padded with whitespace, which never adds an entry*/
+static bool run_kernel(const IndexKernel kernel, StructuralIndex *index)
+{
+    index->count = 0;
+    if (index->indexed >= index->len) { return false; }
+    index->base = index->indexed;
+    const size_t left = index->len - index->base;
+    const size_t window = left < INDEX_WINDOW ? left : INDEX_WINDOW;
+    const size_t blocks_len = window - window % INDEX_BLOCK;
+    const unsigned char *source = (const unsigned char *)index->source + index->base;
+    kernel(index, source, blocks_len, 0);
+    if (blocks_len < window)
+    {
+        unsigned char tail[INDEX_BLOCK];
+        memset(tail, ' ', INDEX_BLOCK);
+        memcpy(tail, source + blocks_len, window - blocks_len);
+        kernel(index, tail, INDEX_BLOCK, blocks_len);
+    }
+    index->indexed += window;
+    return true;
+}
+
+void init_index(StructuralIndex *index, const char *source, const size_t len)
+{
+    index->source = source;
+    index->len = len;
+    index->base = 0;
+    index->indexed = 0;
+    index->escaped = 0;
+    index->in_string = 0;
+    index->scalar = 0;
+    index->line = 1;
+    index->invalid_utf8 = SIZE_MAX;
+    index->utf8_tail = 0;
+    index->count = 0;
+}
+
+bool next_window(StructuralIndex *index)
+{
+    // picked by the first window of any thread, a race only picks the same kernel twice
+    static IndexKernel selected = NULL;
+    IndexKernel kernel = __atomic_load_n(&selected, __ATOMIC_RELAXED);
+    if (kernel == NULL)
+    {
+        kernel = select_kernel();
+        __atomic_store_n(&selected, kernel, __ATOMIC_RELAXED);
+    }
+    return run_kernel(kernel, index);
+}
+
+bool next_window_with(const IndexKernelType type, StructuralIndex *index)
+{
+    const IndexKernel kernel = find_kernel(type);
+    return kernel != NULL && run_kernel(kernel, index);
+}
+
+const char *index_kernel_name(const IndexKernelType type)
+{
+    if (type < 0 || type >= INDEX_KERNEL_COUNT) { return "unknown"; }
+    return kernel_names[type];
+}
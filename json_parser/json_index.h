@@ -0,0 +1,115 @@
+#ifndef JSON_INDEX_H
+#define JSON_INDEX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*the number of bytes indexed at a time, a window can't have more entries than bytes*/
+#define INDEX_WINDOW 4096
+
+/********************************************************************************
+ * The structural index of a JSON document, built by a vectorized pass a window
+ * at a time just ahead of the scanner, so the entries are still in the cache
+ * when the scanner reads them. The entries are every place a token can start
+ * outside of a string: the structural characters ({ } [ ] : ,), the opening
+ * quote of every string, and the first character of every number or keyword.
+ * Quotes escaped by a backslash don't open or close a string.
+ * positions are the offsets of the entries from base (the start of the
+ * window). newlines is a bitmap of the newlines of the window outside of
+ * strings (the scanner doesn't count the ones inside) and block_lines the line
+ * each 64 byte block starts on, which is all it takes to find the line of any
+ * offset. stops is a bitmap of the window, bit i is set if byte i
+ * is a quote, a backslash, or a control character, the only characters that
+ * end or need a check in a string, so the scanner can jump over the rest of a
+ * string without reading it.
+ * escaped, in_string, scalar, and line carry the state at the end of the
+ * window into the next one.
+ * The kernels also check that the document is valid utf-8, only the blocks
+ * with a byte past ascii need a look. invalid_utf8 is the offset of the first
+ * character that is not valid, SIZE_MAX while there is none. Outside of a
+ * string any byte past ascii is an error of the scanner, so it only matters in
+ * the strings. utf8_tail is the end of the last block when it cuts a character
+ * off (the last 4 bytes in memory order), 0 otherwise.
+ ********************************************************************************/
+typedef struct
+{
+    const char *source;
+    size_t len;
+    size_t base;
+    size_t indexed;
+    uint64_t escaped;
+    uint64_t in_string;
+    uint64_t scalar;
+    unsigned int line;
+    size_t invalid_utf8;
+    uint32_t utf8_tail;
+    size_t count;
+    uint32_t positions[INDEX_WINDOW];
+    uint32_t block_lines[INDEX_WINDOW / 64];
+    uint64_t newlines[INDEX_WINDOW / 64];
+    uint64_t stops[INDEX_WINDOW / 64];
+} StructuralIndex;
+
+/*the kernels that classify 64 byte blocks, a kernel is only available if the cpu supports it*/
+typedef enum
+{
+    INDEX_KERNEL_SCALAR,
+    INDEX_KERNEL_SSE2,
+    INDEX_KERNEL_AVX2,
+    INDEX_KERNEL_AVX512,
+    INDEX_KERNEL_COUNT
+} IndexKernelType;
+
+/*starts indexing the len bytes of source, no window is indexed yet*/
+void init_index(StructuralIndex *index, const char *source, const size_t len);
+
+/********************************************************************************
+ * indexes the next window of the document, replacing the entries of the last
+ * one. Returns false when the whole document has been indexed. The kernel is
+ * the fastest one the cpu supports, the CCJP_KERNEL environment variable
+ * (scalar, sse2, avx2, avx512) forces one.
+ ********************************************************************************/
+bool next_window(StructuralIndex *index);
+
+/*next_window with the kernel given, returns false if the cpu does not support it. Every kernel finds the same entries*/
+bool next_window_with(const IndexKernelType type, StructuralIndex *index);
+
+/********************************************************************************
+ * returns the offset in the window of the first quote, backslash, or control
+ * character at or after offset, or -1 if there is none before the end of the
+ * window. offset must not be before the window.
+ ********************************************************************************/
+static inline long next_string_stop(const StructuralIndex *index, const size_t offset)
+{
+    const size_t window = index->indexed - index->base;
+    if (offset >= window) { return -1; }
+    size_t word = offset / 64;
+    uint64_t stops = index->stops[word] & (~0ULL << (offset % 64));
+    while (stops == 0)
+    {
+        if (++word == (window + 63) / 64) { return -1; }
+        stops = index->stops[word];
+    }
+    return word * 64 + __builtin_ctzll(stops);
+}
+
+/*the number of bits set, the scanner isn't built for a popcnt instruction and __builtin_popcountll would be a call*/
+static inline unsigned int count_bits(uint64_t bits)
+{
+    bits -= (bits >> 1) & 0x5555555555555555ULL;
+    bits = (bits & 0x3333333333333333ULL) + ((bits >> 2) & 0x3333333333333333ULL);
+    bits = (bits + (bits >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    return (bits * 0x0101010101010101ULL) >> 56;
+}
+
+/*the line of the character at offset in the window*/
+static inline unsigned int index_line(const StructuralIndex *index, const size_t offset)
+{
+    const uint64_t before = (1ULL << (offset % 64)) - 1;
+    return index->block_lines[offset / 64] + count_bits(index->newlines[offset / 64] & before);
+}
+
+const char *index_kernel_name(const IndexKernelType type);
+
+#endif
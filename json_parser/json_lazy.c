@@ -0,0 +1,324 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "json_lazy.h"
+#include "json_utf8.h"
+
+void init_lazy_parser(LazyParser *lazy)
+{
+    init_scanner(&lazy->scanner, "", 0); // an empty document until lazy_start, lazy_pointer fails on it
+    lazy->current.type = TOKEN_EOF;
+    lazy->error = NULL;
+    lazy->error_line = 0;
+    lazy->key = NULL;
+    lazy->key_capacity = 0;
+}
+
+void free_lazy_parser(LazyParser *lazy)
+{
+    free(lazy->key);
+    init_lazy_parser(lazy);
+}
+
+/*keeps the first error and leaves the lazy parser on no value, always returns false*/
+static bool fail(LazyParser *lazy, const char *message, const unsigned int line)
+{
+    if (lazy->error == NULL)
+    {
+        lazy->error = message;
+        lazy->error_line = line;
+    }
+    lazy->current.type = TOKEN_EOF;
+    return false;
+}
+
+/*a key or index that isn't there, the lazy parser is on no value*/
+static bool not_found(LazyParser *lazy)
+{
+    lazy->current.type = TOKEN_EOF;
+    return false;
+}
+
+static Token next_token(LazyParser *lazy)
+{
+    const Token token = scan_token(&lazy->scanner);
+    if (token.type == TOKEN_ERROR) { fail(lazy, token.message, token.line); }
+    return token;
+}
+
+static bool is_value(const TokenType type)
+{
+    return type == TOKEN_BEGIN_OBJECT || type == TOKEN_BEGIN_ARRAY || type == TOKEN_STRING || type == TOKEN_NUMBER ||
+           type == TOKEN_TRUE || type == TOKEN_FALSE || type == TOKEN_NULL;
+}
+
+/*steps over the value the token begins, an object or array without scanning what is in it*/
+static bool skip_value(LazyParser *lazy, const Token token)
+{
+    if (token.type == TOKEN_ERROR) { return false; }
+    if (!is_value(token.type)) { return fail(lazy, ERROR_EXPECTED_VALUE, token.line); }
+    if (token.type != TOKEN_BEGIN_OBJECT && token.type != TOKEN_BEGIN_ARRAY) { return true; }
+    if (skip_nested(&lazy->scanner)) { return true; }
+    return fail(lazy, "Reached the end of the document inside an object or array.", lazy->scanner.line);
+}
+
+bool lazy_start(LazyParser *lazy, const char *source, const size_t len)
+{
+    lazy->error = NULL;
+    lazy->error_line = 0;
+    init_scanner(&lazy->scanner, source, len);
+    lazy->current = next_token(lazy);
+    if (lazy->current.type == TOKEN_BEGIN_OBJECT || lazy->current.type == TOKEN_BEGIN_ARRAY) { return true; }
+    return fail(lazy, ERROR_NOT_A_DOCUMENT, lazy->current.line);
+}
+
+/********************************************************************************
+ * compares the characters of a string token with escapes to key, one escape at
+ * a time without unescaping the string anywhere. An escape stands for what the
+ * parser unescapes it to: \uXXXX is utf-8, a surrogate pair one character and
+ * a lone surrogate U+FFFD.
+ ********************************************************************************/
+static bool escaped_equals(const char *in, const char *end, const char *key, const size_t len)
+{
+    const char *key_end = key + len;
+    while (in < end)
+    {
+        if (*in != '\\')
+        {
+            if (key == key_end || *key++ != *in++) { return false; }
+            continue;
+        }
+        char unescaped[4];
+        unsigned int count = 1;
+        switch (in[1])
+        {
+            case 'b': unescaped[0] = '\b'; break;
+            case 'f': unescaped[0] = '\f'; break;
+            case 'n': unescaped[0] = '\n'; break;
+            case 'r': unescaped[0] = '\r'; break;
+            case 't': unescaped[0] = '\t'; break;
+            case 'u':
+            {
+                unsigned int escape_len;
+                count = utf8_unescape(in, end, unescaped, &escape_len);
+                in += escape_len - 2; // the 2 of every escape are added below
+                break;
+            }
+            default: unescaped[0] = in[1]; break; // '"', '\\', and '/'
+        }
+        in += 2;
+        if ((size_t)(key_end - key) < count || memcmp(key, unescaped, count) != 0) { return false; }
+        key += count;
+    }
+    return key == key_end;
+}
+
+/*true if the string token is key, the escapes in it stand for the characters they are unescaped to*/
+static bool key_equals(LazyParser *lazy, const Token token, const char *key, const size_t len)
+{
+    const char *in = token.start + 1;
+    const char *end = token.start + token.len - 1;
+    if (!lazy->scanner.escaped) { return (size_t)(end - in) == len && memcmp(in, key, len) == 0; }
+    return escaped_equals(in, end, key, len);
+}
+
+/********************************************************************************
+ * member = string: value
+ * goes through the members of the object in order, the name of each is
+ * compared to key and the value of the ones that aren't it is skipped.
+ ********************************************************************************/
+bool lazy_key(LazyParser *lazy, const char *key, const size_t len)
+{
+    if (lazy->current.type != TOKEN_BEGIN_OBJECT) { return not_found(lazy); }
+    Token token = next_token(lazy);
+    if (token.type == TOKEN_END_OBJECT) { return not_found(lazy); }
+    for (;;)
+    {
+        if (token.type == TOKEN_ERROR) { return false; }
+        if (token.type != TOKEN_STRING) { return fail(lazy, ERROR_EXPECTED_STRING, token.line); }
+        const bool found = key_equals(lazy, token, key, len);
+        token = next_token(lazy);
+        if (token.type == TOKEN_ERROR) { return false; }
+        if (token.type != TOKEN_NAME_SEPARATOR) { return fail(lazy, ERROR_EXPECTED_NAME_SEPARATOR, token.line); }
+        token = next_token(lazy);
+        if (found)
+        {
+            if (token.type == TOKEN_ERROR) { return false; }
+            if (!is_value(token.type)) { return fail(lazy, ERROR_EXPECTED_VALUE, token.line); }
+            lazy->current = token;
+            return true;
+        }
+        if (!skip_value(lazy, token)) { return false; }
+        token = next_token(lazy);
+        if (token.type == TOKEN_END_OBJECT) { return not_found(lazy); }
+        if (token.type == TOKEN_ERROR) { return false; }
+        if (token.type != TOKEN_VALUE_SEPARATOR)
+        {
+            return fail(lazy, ERROR_EXPECTED_OBJECT_END, token.line);
+        }
+        token = next_token(lazy);
+    }
+}
+
+/*goes through the values of the array in order and skips the ones before index*/
+bool lazy_index(LazyParser *lazy, const size_t index)
+{
+    if (lazy->current.type != TOKEN_BEGIN_ARRAY) { return not_found(lazy); }
+    Token token = next_token(lazy);
+    if (token.type == TOKEN_END_ARRAY) { return not_found(lazy); }
+    for (size_t i = 0;; i++)
+    {
+        if (i == index)
+        {
+            if (token.type == TOKEN_ERROR) { return false; }
+            if (!is_value(token.type)) { return fail(lazy, ERROR_EXPECTED_VALUE, token.line); }
+            lazy->current = token;
+            return true;
+        }
+        if (!skip_value(lazy, token)) { return false; }
+        token = next_token(lazy);
+        if (token.type == TOKEN_END_ARRAY) { return not_found(lazy); }
+        if (token.type == TOKEN_ERROR) { return false; }
+        if (token.type != TOKEN_VALUE_SEPARATOR)
+        {
+            return fail(lazy, ERROR_EXPECTED_ARRAY_END, token.line);
+        }
+        token = next_token(lazy);
+    }
+}
+
+/*the length of the reference token at the start of pointer (up to the next '/' or the end), -1 if a '~' in it is not ~0 or ~1*/
+static long reference_length(const char *pointer, const char *end)
+{
+    const char *c = pointer;
+    for (; c < end && *c != '/'; c++)
+    {
+        if (*c == '~' && (c + 1 == end || (c[1] != '0' && c[1] != '1'))) { return -1; }
+    }
+    return c - pointer;
+}
+
+/*an array index is 0 or a number without leading zeroes, "-" (past the last value) or anything else is not one*/
+static bool reference_index(const char *reference, const size_t len, size_t *index)
+{
+    if (len == 0 || len > 18 || (reference[0] == '0' && len > 1)) { return false; }
+    *index = 0;
+    for (size_t i = 0; i < len; i++)
+    {
+        if (reference[i] < '0' || reference[i] > '9') { return false; }
+        *index = *index * 10 + (reference[i] - '0');
+    }
+    return true;
+}
+
+/*writes the reference token with ~1 as '/' and ~0 as '~' to out, which has room for len bytes, and returns its length*/
+static size_t unescape_reference(const char *reference, const size_t len, char *out)
+{
+    size_t written = 0;
+    for (size_t i = 0; i < len; i++)
+    {
+        if (reference[i] == '~')
+        {
+            out[written++] = reference[++i] == '1' ? '/' : '~';
+            continue;
+        }
+        out[written++] = reference[i];
+    }
+    return written;
+}
+
+bool lazy_pointer(LazyParser *lazy, const char *pointer, const size_t len)
+{
+    if (!lazy_start(lazy, lazy->scanner.source, lazy->scanner.end - lazy->scanner.source)) { return false; }
+    const char *end = pointer + len;
+    if (len > 0 && *pointer != '/') { return fail(lazy, "Invalid JSON Pointer.", 0); }
+    while (pointer < end)
+    {
+        pointer++; // the '/'
+        const long reference_len = reference_length(pointer, end);
+        if (reference_len < 0) { return fail(lazy, "Invalid JSON Pointer.", 0); }
+        if (lazy->current.type == TOKEN_BEGIN_ARRAY)
+        {
+            size_t index;
+            if (!reference_index(pointer, reference_len, &index) || !lazy_index(lazy, index)) { return not_found(lazy); }
+        }
+        else
+        {
+            if ((size_t)reference_len > lazy->key_capacity)
+            {
+                char *key = (char *)realloc(lazy->key, reference_len);
+                if (key == NULL) { return fail(lazy, "Out of memory.", 0); }
+                lazy->key = key;
+                lazy->key_capacity = reference_len;
+            }
+            const size_t key_len = unescape_reference(pointer, reference_len, lazy->key);
+            if (!lazy_key(lazy, lazy->key, key_len)) { return false; }
+        }
+        pointer += reference_len;
+    }
+    return true;
+}
+
+bool lazy_value(LazyParser *lazy, LazyValue *value)
+{
+    const Token token = lazy->current;
+    value->text = token.start;
+    value->len = token.len;
+    switch (token.type)
+    {
+        case TOKEN_BEGIN_OBJECT:
+        case TOKEN_BEGIN_ARRAY:
+            value->type = token.type == TOKEN_BEGIN_OBJECT ? VALUE_OBJECT : VALUE_ARRAY;
+            if (!skip_value(lazy, token)) { return false; }
+            value->len = lazy->scanner.current - token.start;
+            lazy->current.type = TOKEN_EOF;
+            return true;
+        case TOKEN_STRING: value->type = VALUE_STRING; return true;
+        case TOKEN_NUMBER: value->type = VALUE_NUMBER; return true;
+        case TOKEN_TRUE: value->type = VALUE_TRUE; return true;
+        case TOKEN_FALSE: value->type = VALUE_FALSE; return true;
+        case TOKEN_NULL: value->type = VALUE_NULL; return true;
+        default: return false;
+    }
+}
+
+/*true if the reference token (with its ~0 and ~1) is key*/
+static bool reference_equals(const char *reference, const size_t len, const char *key, const size_t key_len)
+{
+    size_t k = 0;
+    for (size_t i = 0; i < len; i++, k++)
+    {
+        char c = reference[i];
+        if (c == '~') { c = reference[++i] == '1' ? '/' : '~'; }
+        if (k == key_len || key[k] != c) { return false; }
+    }
+    return k == key_len;
+}
+
+const Value *value_at_pointer(const Value *root, const char *pointer, const size_t len)
+{
+    const char *end = pointer + len;
+    if (len > 0 && *pointer != '/') { return NULL; }
+    const Value *value = root;
+    while (value != NULL && pointer < end)
+    {
+        pointer++; // the '/'
+        const long reference_len = reference_length(pointer, end);
+        if (reference_len < 0) { return NULL; }
+        const Value *found = NULL;
+        size_t index;
+        if (value->type == VALUE_ARRAY && reference_index(pointer, reference_len, &index) && index < value->len)
+        {
+            found = &value->values[index];
+        }
+        for (unsigned int i = 0; value->type == VALUE_OBJECT && i < value->len && found == NULL; i++)
+        {
+            const Member *member = &value->members[i];
+            if (reference_equals(pointer, reference_len, member->key, member->key_len)) { found = &member->value; }
+        }
+        value = found;
+        pointer += reference_len;
+    }
+    return value;
+}
@@ -0,0 +1,84 @@
+#ifndef JSON_LAZY_H
+#define JSON_LAZY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "json_parser.h"
+#include "json_scanner.h"
+
+/*a value as written in the document: a string with its quotes and escapes, an object or array all of it*/
+typedef struct
+{
+    ValueType type;
+    const char *text;
+    size_t len;
+} LazyValue;
+
+/********************************************************************************
+ * Goes through a document on demand, as far as it is asked to and no further.
+ * The lazy parser is always on a value (current is its first token), starting
+ * on the root, and only moves forward: into an object to the value of a key,
+ * or into an array to the value at an index. The members or values before it
+ * are stepped over, the objects and arrays among them with skip_nested, which
+ * only counts their brackets in the index, so nothing in them is scanned.
+ * Only what is read is checked, an error in a part that is skipped is not
+ * noticed (parse the document to validate it).
+ * When a key or index isn't there the lazy parser is on no value (current is
+ * EOF) until it starts again. error is the first error of the document (or of
+ * a JSON Pointer) and its line, NULL if there was none. key is the reference
+ * token of a JSON Pointer with its escapes replaced, it is kept between
+ * lookups.
+ ********************************************************************************/
+typedef struct
+{
+    Scanner scanner;
+    Token current;
+    const char *error;
+    unsigned int error_line;
+    char *key;
+    size_t key_capacity;
+} LazyParser;
+
+/*initializes a lazy parser on an empty document, must be called before it is first started*/
+void init_lazy_parser(LazyParser *lazy);
+
+/*frees the memory the lazy parser kept between lookups*/
+void free_lazy_parser(LazyParser *lazy);
+
+/********************************************************************************
+ * starts on the root of the JSON document of len bytes, it doesn't have to be
+ * NUL terminated and has to be kept while it is read. Returns false if the
+ * document doesn't start with an object or array.
+ ********************************************************************************/
+bool lazy_start(LazyParser *lazy, const char *source, const size_t len);
+
+/*moves from the object the lazy parser is on to the value of the first member named key, false if there is none*/
+bool lazy_key(LazyParser *lazy, const char *key, const size_t len);
+
+/*moves from the array the lazy parser is on to its value at index (from 0), false if there is none*/
+bool lazy_index(LazyParser *lazy, const size_t index);
+
+/********************************************************************************
+ * starts again on the root of the document given to lazy_start and moves to
+ * the value at the JSON Pointer (RFC 6901) of len bytes. Before lazy_start the
+ * document is empty and it fails like lazy_start does on one. "" is the root,
+ * and every "/token" is a key of an object or an index of an array, "~1" in a
+ * token stands for '/' and "~0" for '~'.
+ * Returns false if there is no such value, or if the pointer is not valid
+ * (error is then "Invalid JSON Pointer.").
+ ********************************************************************************/
+bool lazy_pointer(LazyParser *lazy, const char *pointer, const size_t len);
+
+/********************************************************************************
+ * the value the lazy parser is on, as written. An object or array is found by
+ * skipping to its end, the lazy parser is then past it and on no value.
+ * parse_document on the text of a value builds (and validates) it, and
+ * number_to_double reads a number.
+ ********************************************************************************/
+bool lazy_value(LazyParser *lazy, LazyValue *value);
+
+/*the value at the JSON Pointer of len bytes in a document model, NULL if there is none or the pointer is not valid*/
+const Value *value_at_pointer(const Value *root, const char *pointer, const size_t len);
+
+#endif
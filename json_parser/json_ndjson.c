@@ -0,0 +1,194 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "json_ndjson.h"
+
+/*the document is split into chunks of about this size, small enough to keep every worker busy until the end*/
+#define NDJSON_CHUNK (1u << 20)
+
+/*what the records of a chunk found, the lines count from the start of the chunk*/
+typedef struct
+{
+    size_t lines;
+    size_t records;
+    size_t invalid;
+    RecordError *errors;
+    size_t error_count;
+    size_t error_capacity;
+} ChunkResult;
+
+/*shared by the workers of a single parse_ndjson call*/
+typedef struct
+{
+    const char *source;
+    size_t len;
+    size_t chunk_count;
+    ChunkResult *chunks;
+    atomic_size_t next;
+    RecordHandler on_record;
+    void *context;
+} Ndjson;
+
+/*returns the offset where a chunk starts, the even split is moved forward to the start of the next line*/
+static size_t chunk_start(const Ndjson *ndjson, const size_t index)
+{
+    if (index >= ndjson->chunk_count) { return ndjson->len; }
+    if (index == 0) { return 0; }
+    const size_t pos = index * NDJSON_CHUNK - 1; // a chunk starts right after a newline
+    const char *newline = (const char *)memchr(ndjson->source + pos, '\n', ndjson->len - pos);
+    return newline == NULL ? ndjson->len : newline - ndjson->source + 1;
+}
+
+static void add_error(ChunkResult *chunk, const size_t line, const char *message)
+{
+    chunk->invalid++;
+    if (chunk->error_count == chunk->error_capacity)
+    {
+        const size_t capacity = chunk->error_capacity == 0 ? 16 : chunk->error_capacity * 2;
+        RecordError *errors = (RecordError *)realloc(chunk->errors, capacity * sizeof(RecordError));
+        if (errors == NULL) { return; } // counted but not kept
+        chunk->errors = errors;
+        chunk->error_capacity = capacity;
+    }
+    chunk->errors[chunk->error_count++] = (RecordError){line, message};
+}
+
+/*whitespaces = newline, tab, space, and return*/
+static bool is_blank(const char *line, const size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        if (line[i] != ' ' && line[i] != '\t' && line[i] != '\r') { return false; }
+    }
+    return true;
+}
+
+/*parses the record on the last line of the chunk*/
+static void parse_record(Ndjson *ndjson, Parser *parser, ChunkResult *chunk, const char *record, size_t len)
+{
+    if (len > 0 && record[len - 1] == '\r') { len--; }
+    if (is_blank(record, len)) { return; }
+    chunk->records++;
+    if (ndjson->on_record == NULL)
+    {
+        if (!parse(parser, record, len)) { add_error(chunk, chunk->lines, parser->error); }
+        return;
+    }
+    Document *document = parse_document(parser, record, len);
+    if (document == NULL)
+    {
+        add_error(chunk, chunk->lines, parser->error);
+        return;
+    }
+    ndjson->on_record(ndjson->context, record - ndjson->source, document);
+}
+
+static void parse_chunk(Ndjson *ndjson, Parser *parser, const size_t index)
+{
+    ChunkResult *chunk = &ndjson->chunks[index];
+    const char *line = ndjson->source + chunk_start(ndjson, index);
+    const char *end = ndjson->source + chunk_start(ndjson, index + 1);
+    while (line < end)
+    {
+        const char *newline = (const char *)memchr(line, '\n', end - line);
+        const char *line_end = newline == NULL ? end : newline;
+        chunk->lines++;
+        parse_record(ndjson, parser, chunk, line, line_end - line);
+        if (newline == NULL) { break; }
+        line = newline + 1;
+    }
+}
+
+/*takes the next chunk until there are none left, with a parser of its own*/
+static void *worker(void *data)
+{
+    Ndjson *ndjson = (Ndjson *)data;
+    Parser parser;
+    init_parser(&parser);
+    for (;;)
+    {
+        const size_t index = atomic_fetch_add_explicit(&ndjson->next, 1, memory_order_relaxed);
+        if (index >= ndjson->chunk_count) { break; }
+        parse_chunk(ndjson, &parser, index);
+    }
+    free_parser(&parser);
+    return NULL;
+}
+
+/*runs the workers, the calling thread is one of them*/
+static void run_workers(Ndjson *ndjson, unsigned int threads)
+{
+    if (threads > ndjson->chunk_count) { threads = ndjson->chunk_count; }
+    pthread_t *ids = threads > 1 ? (pthread_t *)malloc(sizeof(pthread_t) * (threads - 1)) : NULL;
+    unsigned int started = 0;
+    if (ids != NULL)
+    {
+        while (started < threads - 1 && pthread_create(&ids[started], NULL, worker, ndjson) == 0) { started++; }
+    }
+    worker(ndjson);
+    for (unsigned int i = 0; i < started; i++) { pthread_join(ids[i], NULL); }
+    free(ids);
+}
+
+/*merges the chunks in order, the lines of a chunk start after the lines of the chunks before it*/
+static void merge_chunks(const Ndjson *ndjson, NdjsonResult *result)
+{
+    size_t error_count = 0;
+    for (size_t i = 0; i < ndjson->chunk_count; i++) { error_count += ndjson->chunks[i].error_count; }
+    result->errors = error_count == 0 ? NULL : (RecordError *)malloc(error_count * sizeof(RecordError));
+
+    for (size_t i = 0; i < ndjson->chunk_count; i++)
+    {
+        const ChunkResult *chunk = &ndjson->chunks[i];
+        for (size_t e = 0; e < chunk->error_count && result->errors != NULL; e++)
+        {
+            result->errors[result->error_count++] = (RecordError){result->lines + chunk->errors[e].line, chunk->errors[e].message};
+        }
+        result->lines += chunk->lines;
+        result->records += chunk->records;
+        result->invalid += chunk->invalid;
+        free(chunk->errors);
+    }
+}
+
+bool parse_ndjson(const char *source, const size_t len, unsigned int threads, RecordHandler on_record, void *context,
+                  NdjsonResult *result)
+{
+    *result = (NdjsonResult){0, 0, 0, NULL, 0};
+    if (threads == 0)
+    {
+        const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus < 1 ? 1 : cpus;
+    }
+
+    Ndjson ndjson = {.source = source, .len = len, .on_record = on_record, .context = context};
+    ndjson.chunk_count = (len + NDJSON_CHUNK - 1) / NDJSON_CHUNK;
+    atomic_init(&ndjson.next, 0);
+    if (ndjson.chunk_count == 0) { return true; }
+    ndjson.chunks = (ChunkResult *)calloc(ndjson.chunk_count, sizeof(ChunkResult));
+    if (ndjson.chunks == NULL)
+    {
+        // no memory to split it, it is parsed as a single chunk
+        ChunkResult chunk = {0};
+        ndjson.chunks = &chunk;
+        ndjson.chunk_count = 1;
+        worker(&ndjson);
+        merge_chunks(&ndjson, result);
+        return result->invalid == 0;
+    }
+
+    run_workers(&ndjson, threads);
+    merge_chunks(&ndjson, result);
+    free(ndjson.chunks);
+    return result->invalid == 0;
+}
+
+void free_ndjson_result(NdjsonResult *result)
+{
+    free(result->errors);
+    result->errors = NULL;
+    result->error_count = 0;
+}
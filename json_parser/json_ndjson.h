@@ -0,0 +1,57 @@
+#ifndef JSON_NDJSON_H
+#define JSON_NDJSON_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "json_parser.h"
+
+/*a record that is not valid JSON, line counts from 1 like the scanner*/
+typedef struct
+{
+    size_t line;
+    const char *message;
+} RecordError;
+
+/********************************************************************************
+ * called for every valid record when the records are parsed into documents. It
+ * runs on the worker thread that parsed the record, so records come in no
+ * particular order and the handler has to be thread safe. offset is where the
+ * record starts in the NDJSON document. The handler owns the document and frees
+ * it with free_document.
+ ********************************************************************************/
+typedef void (*RecordHandler)(void *context, const size_t offset, Document *document);
+
+/********************************************************************************
+ * what parse_ndjson found. records are the lines that are not blank, invalid
+ * the records that are not valid JSON. errors are the invalid records in the
+ * order of their lines, error_count is less than invalid only if there was no
+ * memory left to keep them all.
+ ********************************************************************************/
+typedef struct
+{
+    size_t lines;
+    size_t records;
+    size_t invalid;
+    RecordError *errors;
+    size_t error_count;
+} NdjsonResult;
+
+/********************************************************************************
+ * parses an NDJSON (JSON Lines) document of len bytes, a JSON document on every
+ * line. Blank lines are skipped and a '\r' before the '\n' is allowed. A record
+ * can't span lines, a newline in a string has to be escaped, so the document is
+ * split at newlines into chunks that are parsed on a pool of up to threads
+ * worker threads (0 for one per cpu), each with its own parser.
+ * With on_record NULL the records are only validated, otherwise every valid
+ * record is parsed into a document and handed to on_record.
+ * Returns true if every record was valid. The errors are kept in result until
+ * free_ndjson_result.
+ ********************************************************************************/
+bool parse_ndjson(const char *source, const size_t len, unsigned int threads, RecordHandler on_record, void *context,
+                  NdjsonResult *result);
+
+/*frees the errors of the result*/
+void free_ndjson_result(NdjsonResult *result);
+
+#endif
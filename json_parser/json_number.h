@@ -0,0 +1,49 @@
+#ifndef JSON_NUMBER_H
+#define JSON_NUMBER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*the most significant digits that always fit in the 64 bit mantissa*/
+#define NUMBER_MAX_DIGITS 19
+
+/********************************************************************************
+ * A number as its digits are read: the value is mantissa * 10^exponent.
+ * The scanner adds every digit to mantissa and counts them in digits, more than
+ * 19 digits may not fit and the number is read again from its lexeme. Read
+ * from a lexeme, mantissa holds the first 19 significant digits and digits
+ * counts those. A digit past them only moves the exponent in the whole part,
+ * and if it is not a 0 the number is truncated and mantissa is no longer
+ * exact. integer is set while there is no fraction or exponent.
+ ********************************************************************************/
+typedef struct
+{
+    uint64_t mantissa;
+    int64_t exponent;
+    unsigned int digits;
+    bool negative;
+    bool integer;
+    bool truncated;
+} NumberParts;
+
+/********************************************************************************
+ * the correctly rounded double of the number. A mantissa of at most 2^53 with a
+ * power of ten up to 10^22 is exact with a single multiplication or division,
+ * the rest is done with the Eisel-Lemire algorithm (a 128 bit product with a
+ * table of the powers of ten). The rare numbers it can't decide, truncated
+ * ones, and those past the normal doubles are read from the lexeme with
+ * strtod in the C locale.
+ ********************************************************************************/
+double number_value(const NumberParts *number, const char *lexeme, const size_t len);
+
+/*the number as an int64, false if it has a fraction or exponent or doesn't fit*/
+bool number_int64(const NumberParts *number, int64_t *integer);
+
+/*the double of a number lexeme (one the scanner accepted), independent of the locale*/
+double number_to_double(const char *lexeme, const size_t len);
+
+/*the int64 of a number lexeme (one the scanner accepted), false if it is not an integer that fits*/
+bool number_to_int64(const char *lexeme, const size_t len, int64_t *integer);
+
+#endif
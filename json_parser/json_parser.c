@@ -1,146 +1,552 @@
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
+#include "json_parser.h"
 #include "json_scanner.h"
+#include "json_tape.h"
+#include "json_utf8.h"
 
-typedef struct
-{
-    Token previous;
-    Token current;
-    bool had_error;
-    bool panic_mode;
-} Parser;
-
-Parser parser;
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
+/*keeps the first error of the parse and where it was*/
+static void record_error(Parser *parser, const char *message)
+{
+    parser->had_error = true;
+    if (parser->error != NULL) { return; }
+    parser->error = message;
+    parser->error_line = parser->tape != NULL ? tape_line(parser->tape, parser->tape_next - 1) : parser->current.line;
+}
 
-static void parse_value();
+static void report_error_token(Parser *parser)
+{
+    record_error(parser, parser->current.message);
+}
 
-static void report_error_token()
+static void report_parse_error(Parser *parser, const char *message)
 {
-    parser.had_error = true;
+    record_error(parser, message);
+    if (parser->panic_mode) { return; }
+}
 
+static void report_out_of_memory(Parser *parser)
+{
+    record_error(parser, "Out of memory.");
+    parser->arena = NULL; // stop building, the document is discarded
 }
 
-static void report_parse_error(const char *message)
+/********************************************************************************
+ * the next token of the tape, the EOF at its end repeats like the scanner's.
+ * The parser only reads the lexemes of strings and numbers, the rest only get
+ * their type (and an error its message).
+ ********************************************************************************/
+static Token next_tape_token(Parser *parser)
 {
-    parser.had_error = true;
-    if (parser.panic_mode) { return; }
+    const TokenTape *tape = parser->tape;
+    if (parser->tape_next < tape->count) { parser->tape_next++; }
+    const size_t entry = parser->tape_next - 1;
+    const TokenType type = tape_type(tape, entry);
+    if (type == TOKEN_STRING || type == TOKEN_NUMBER || type == TOKEN_ERROR) { return tape_token(tape, entry); }
+    Token token = {.type = type, .start = NULL, .len = 0, .message = "", .msg_len = 0, .line = 0};
+    return token;
 }
 
-static void advance()
+static void advance(Parser *parser)
 {
-    parser.previous = parser.current;
-    parser.current = scan_token();
-    if (parser.current.type == TOKEN_ERROR)
+    parser->previous = parser->current;
+    if (parser->stopped)
+    {
+        parser->current.type = TOKEN_EOF; // unwinds the parse without reading any further
+        return;
+    }
+    parser->current = parser->tape != NULL ? next_tape_token(parser) : scan_token(&parser->scanner);
+    if (parser->current.type == TOKEN_ERROR)
     {
-        report_error_token();
+        report_error_token(parser);
     }
 }
 
-static const bool match(TokenType type)
+static const bool match(Parser *parser, TokenType type)
 {
-    if (parser.current.type == type)
+    if (parser->current.type == type)
     {
-        advance();
+        advance(parser);
         return true;
     }
     return false;
 }
 
-/* member = string: value */
-static void parse_member()
+/********************************************************************************
+ * hands the event of the token to the sax handler. A string is a key when
+ * is_key is set, the slices leave out the quotes. Nothing is handed out after
+ * the first error, and a callback that returns false stops the parse.
+ ********************************************************************************/
+static void emit(Parser *parser, const Token token, const bool is_key)
 {
-    if (!match(TOKEN_STRING))
+    const SaxHandler *sax = parser->sax;
+    void *context = parser->sax_context;
+    if (sax == NULL || parser->had_error) { return; }
+    bool go_on = true;
+    switch (token.type)
     {
-        report_parse_error("Tried to parse a string and didnt find one.");
+        case TOKEN_BEGIN_OBJECT: if (sax->start_object != NULL) { go_on = sax->start_object(context); } break;
+        case TOKEN_END_OBJECT: if (sax->end_object != NULL) { go_on = sax->end_object(context); } break;
+        case TOKEN_BEGIN_ARRAY: if (sax->start_array != NULL) { go_on = sax->start_array(context); } break;
+        case TOKEN_END_ARRAY: if (sax->end_array != NULL) { go_on = sax->end_array(context); } break;
+        case TOKEN_STRING:
+            if (is_key && sax->key != NULL) { go_on = sax->key(context, token.start + 1, token.len - 2); }
+            if (!is_key && sax->string != NULL) { go_on = sax->string(context, token.start + 1, token.len - 2); }
+            break;
+        case TOKEN_NUMBER: if (sax->number != NULL) { go_on = sax->number(context, token.start, token.len); } break;
+        case TOKEN_TRUE: if (sax->boolean != NULL) { go_on = sax->boolean(context, true); } break;
+        case TOKEN_FALSE: if (sax->boolean != NULL) { go_on = sax->boolean(context, false); } break;
+        case TOKEN_NULL: if (sax->null != NULL) { go_on = sax->null(context); } break;
+        default: break;
     }
-    if (!match(TOKEN_NAME_SEPARATOR))
+    if (!go_on)
     {
-        report_parse_error("Tried to parse a name separator but didnt find one.");
+        record_error(parser, "Stopped by the handler.");
+        parser->stopped = true;
     }
-    parse_value();
-    return;
 }
 
-/* object = { member *(, member) } */
-static void parse_object()
+/*pushes size bytes onto the scratch stack, it doubles when it is full*/
+static void push(Parser *parser, const void *item, const size_t size)
 {
-    advance();
-    if (match(TOKEN_END_OBJECT)) { return; }
-    parse_member();
-    while (match(TOKEN_VALUE_SEPARATOR))
+    Stack *stack = &parser->stack;
+    if (stack->len + size > stack->capacity)
     {
-        parse_member();
+        size_t capacity = stack->capacity == 0 ? 4096 : stack->capacity * 2;
+        while (capacity < stack->len + size) { capacity *= 2; }
+        char *data = (char *)realloc(stack->data, capacity);
+        if (data == NULL)
+        {
+            report_out_of_memory(parser);
+            return;
+        }
+        stack->data = data;
+        stack->capacity = capacity;
     }
-    if (!match(TOKEN_END_OBJECT))
+    memcpy(stack->data + stack->len, item, size);
+    stack->len += size;
+}
+
+/*moves everything on the stack above base into the arena*/
+static void *pop_into_arena(Parser *parser, const size_t base)
+{
+    const size_t len = parser->stack.len - base;
+    parser->stack.len = base;
+    if (parser->arena == NULL || len == 0) { return NULL; }
+    void *items = arena_copy(parser->arena, parser->stack.data + base, len);
+    if (items == NULL) { report_out_of_memory(parser); }
+    return items;
+}
+
+/********************************************************************************
+ * copies the characters from in up to the next backslash (or end) to write and
+ * returns where it stopped. With SSE2 the characters are copied 16 at a time,
+ * a whole block is stored before the backslash in it is found. That only
+ * writes past the copy while 16 bytes of the lexeme are left, and the output
+ * is never ahead of the input, so it stays inside the string's allocation.
+ ********************************************************************************/
+static const char *copy_plain(const char *in, const char *end, char **write)
+{
+#ifdef __SSE2__
+    while (end - in >= 16)
     {
-        report_parse_error("Expected '}' to end an object or ',' to to seperate members.");
+        const __m128i block = _mm_loadu_si128((const __m128i *)in);
+        _mm_storeu_si128((__m128i *)*write, block);
+        const unsigned int backslash = _mm_movemask_epi8(_mm_cmpeq_epi8(block, _mm_set1_epi8('\\')));
+        if (backslash != 0)
+        {
+            *write += __builtin_ctz(backslash);
+            return in + __builtin_ctz(backslash);
+        }
+        in += 16;
+        *write += 16;
     }
-    return;
+#endif
+    const char *escape = memchr(in, '\\', end - in);
+    if (escape == NULL) { escape = end; }
+    memcpy(*write, in, escape - in);
+    *write += escape - in;
+    return escape;
 }
 
-/*array = [ value *(value) ]*/
-static void parse_array()
+/********************************************************************************
+ * copies the string token into the arena without its quotes and with the
+ * escapes replaced by the characters they stand for. \uXXXX is written as
+ * utf-8, a surrogate pair becomes one 4 byte character and a lone surrogate is
+ * replaced with U+FFFD. The result is never longer than the lexeme.
+ ********************************************************************************/
+static const char *unescape_string(Parser *parser, const Token token, unsigned int *len)
 {
-    advance();
-    if (match(TOKEN_END_ARRAY)) { return; }
-    parse_value();
-    while (match(TOKEN_VALUE_SEPARATOR))
+    const char *in = token.start + 1;
+    const char *end = token.start + token.len - 1;
+    char *out = (char *)arena_alloc(parser->arena, end - in + 1);
+    if (out == NULL)
     {
-        parse_value();
+        report_out_of_memory(parser);
+        return NULL;
     }
-    if (!match(TOKEN_END_ARRAY))
+    char *write = out;
+    while (in < end)
     {
-        report_parse_error("Expected ']' to end an array or ',' to separate values.");
+        in = copy_plain(in, end, &write);
+        if (in == end) { break; }
+
+        switch (in[1])
+        {
+            case 'b': *write++ = '\b'; break;
+            case 'f': *write++ = '\f'; break;
+            case 'n': *write++ = '\n'; break;
+            case 'r': *write++ = '\r'; break;
+            case 't': *write++ = '\t'; break;
+            case 'u':
+            {
+                unsigned int escape_len;
+                write += utf8_unescape(in, end, write, &escape_len);
+                in += escape_len;
+                continue;
+            }
+            default: *write++ = in[1]; break; // '"', '\\', and '/'
+        }
+        in += 2;
     }
-    return;
+    *write = '\0';
+    *len = write - out;
+    return out;
 }
 
-/*value = object | array | string | number | true | false | null*/
-static void parse_value()
+/********************************************************************************
+ * the characters of a string token, which is the last one the scanner scanned.
+ * A string without escapes is its lexeme, so it points into the source and
+ * nothing is copied, only a string with escapes is unescaped into the arena.
+ ********************************************************************************/
+static const char *string_value(Parser *parser, const Token token, unsigned int *len)
 {
-    switch (parser.current.type)
+    const bool escaped = parser->tape != NULL ? parser->tape->entries[parser->tape_next - 1] & TAPE_ESCAPED : parser->scanner.escaped;
+    if (escaped) { return unescape_string(parser, token, len); }
+    *len = token.len - 2;
+    return token.start + 1;
+}
+
+/*the value of a string, number, or literal token*/
+static Value token_value(Parser *parser, const Token token)
+{
+    Value value = {.len = 0};
+    switch (token.type)
     {
-        case TOKEN_BEGIN_OBJECT: parse_object(); return;
-        case TOKEN_BEGIN_ARRAY: parse_array(); return;
-        case TOKEN_STRING: advance(); return;
-        case TOKEN_NUMBER: advance(); return;
-        case TOKEN_TRUE: advance(); return;
-        case TOKEN_FALSE: advance(); return;
-        case TOKEN_NULL: advance(); return;
-        default:
-            report_parse_error("Tried to parse a value but non was found.");
-            return;
+        case TOKEN_STRING:
+            value.type = VALUE_STRING;
+            if (parser->arena != NULL) { value.string = string_value(parser, token, &value.len); }
+            break;
+        case TOKEN_NUMBER:
+            value.type = VALUE_NUMBER;
+            value.lexeme = token.start;
+            value.len = token.len;
+            // the scanner read the parts of the number, it is the last token it scanned, a tape only has the lexeme
+            if (parser->arena != NULL && parser->tape != NULL) { value.number = number_to_double(token.start, token.len); }
+            else if (parser->arena != NULL) { value.number = number_value(&parser->scanner.number, token.start, token.len); }
+            break;
+        case TOKEN_TRUE: value.type = VALUE_TRUE; break;
+        case TOKEN_FALSE: value.type = VALUE_FALSE; break;
+        default: value.type = VALUE_NULL; break;
+    }
+    return value;
+}
+
+/*starts a member of the object that is open, the key waits on the scratch stack for its value*/
+static void start_member(Parser *parser)
+{
+    Member member = {.key = NULL, .key_len = 0};
+    if (parser->current.type == TOKEN_STRING && parser->arena != NULL)
+    {
+        member.key = string_value(parser, parser->current, &member.key_len);
+    }
+    if (parser->current.type == TOKEN_STRING) { emit(parser, parser->current, true); }
+    if (!match(parser, TOKEN_STRING))
+    {
+        report_parse_error(parser, ERROR_EXPECTED_STRING);
+    }
+    if (!match(parser, TOKEN_NAME_SEPARATOR))
+    {
+        report_parse_error(parser, ERROR_EXPECTED_NAME_SEPARATOR);
+    }
+    if (parser->arena != NULL) { push(parser, &member, sizeof(member)); }
+}
+
+/********************************************************************************
+ * opens the object or array the current token begins. Its level of the nesting
+ * is where its members or values start on the scratch stack, with the low bit
+ * set for an object (every item on the stack is a multiple of 8 bytes).
+ * Returns false if it is nested deeper than max_depth.
+ ********************************************************************************/
+static bool open_nested(Parser *parser)
+{
+    if (parser->depth == parser->max_depth)
+    {
+        report_parse_error(parser, ERROR_TOO_DEEP);
+        return false;
+    }
+    if (parser->depth == parser->nesting_capacity)
+    {
+        const size_t capacity = parser->nesting_capacity == 0 ? 64 : parser->nesting_capacity * 2;
+        size_t *nesting = (size_t *)realloc(parser->nesting, capacity * sizeof(size_t));
+        if (nesting == NULL)
+        {
+            report_out_of_memory(parser);
+            return false;
+        }
+        parser->nesting = nesting;
+        parser->nesting_capacity = capacity;
+    }
+    parser->nesting[parser->depth++] = parser->stack.len | (parser->current.type == TOKEN_BEGIN_OBJECT);
+    emit(parser, parser->current, false);
+    advance(parser);
+    return true;
+}
+
+/*closes the object or array that is open, its members or values are moved from the scratch stack into the arena*/
+static Value close_nested(Parser *parser)
+{
+    const size_t level = parser->nesting[--parser->depth];
+    const size_t base = level & ~(size_t)1;
+    Value value = {.len = 0};
+    if (level & 1)
+    {
+        value.type = VALUE_OBJECT;
+        value.len = (parser->stack.len - base) / sizeof(Member);
+        value.members = (Member *)pop_into_arena(parser, base);
+    }
+    else
+    {
+        value.type = VALUE_ARRAY;
+        value.len = (parser->stack.len - base) / sizeof(Value);
+        value.values = (Value *)pop_into_arena(parser, base);
+    }
+    return value;
+}
+
+/*adds a value to the object or array that is open, a member's key is already on the top of the stack*/
+static void add_value(Parser *parser, const bool in_object, const Value *value)
+{
+    if (parser->arena == NULL) { return; }
+    if (!in_object)
+    {
+        push(parser, value, sizeof(Value));
+        return;
+    }
+    memcpy(parser->stack.data + parser->stack.len - sizeof(Member) + offsetof(Member, value), value, sizeof(Value));
+}
+
+/********************************************************************************
+ * object = { member *(, member) }
+ * member = string: value
+ * array = [ value *(, value) ]
+ * value = object | array | string | number | true | false | null
+ * Parses the object or array the current token begins without recursion, the
+ * objects and arrays that are open are kept in nesting, so the depth of a
+ * document doesn't depend on the C stack. A value that is done goes to the
+ * object or array it is in, which then goes on with its next value after a ','
+ * or ends. The parse stops at the first error, it is the one that is kept.
+ ********************************************************************************/
+static Value parse_nested(Parser *parser)
+{
+    Value value = {.type = VALUE_NULL, .len = 0};
+    for (;;)
+    {
+        switch (parser->current.type)
+        {
+            case TOKEN_BEGIN_OBJECT:
+            case TOKEN_BEGIN_ARRAY:
+            {
+                const bool object = parser->current.type == TOKEN_BEGIN_OBJECT;
+                if (!open_nested(parser)) { return value; }
+                const TokenType end = object ? TOKEN_END_OBJECT : TOKEN_END_ARRAY;
+                if (parser->current.type == end)
+                {
+                    emit(parser, parser->current, false);
+                    advance(parser);
+                    value = close_nested(parser);
+                    break;
+                }
+                if (object) { start_member(parser); }
+                if (parser->had_error) { return value; }
+                continue; // the first value
+            }
+            case TOKEN_STRING:
+            case TOKEN_NUMBER:
+            case TOKEN_TRUE:
+            case TOKEN_FALSE:
+            case TOKEN_NULL:
+                value = token_value(parser, parser->current);
+                emit(parser, parser->current, false);
+                advance(parser);
+                break;
+            default:
+                report_parse_error(parser, ERROR_EXPECTED_VALUE);
+                return value;
+        }
+
+        // the value is done, the objects and arrays it ends go on with their next value
+        for (;;)
+        {
+            if (parser->had_error || parser->depth == 0) { return value; }
+            const bool in_object = parser->nesting[parser->depth - 1] & 1;
+            add_value(parser, in_object, &value);
+            if (match(parser, TOKEN_VALUE_SEPARATOR))
+            {
+                if (in_object) { start_member(parser); }
+                break;
+            }
+            const TokenType end = in_object ? TOKEN_END_OBJECT : TOKEN_END_ARRAY;
+            if (parser->current.type == end) { emit(parser, parser->current, false); }
+            if (!match(parser, end))
+            {
+                report_parse_error(parser, in_object ? ERROR_EXPECTED_OBJECT_END : ERROR_EXPECTED_ARRAY_END);
+                return value;
+            }
+            value = close_nested(parser);
+        }
+        if (parser->had_error) { return value; }
     }
 }
 
-static void start_parse()
+static Value start_parse(Parser *parser)
 {
-    switch (parser.current.type)
+    Value value = {.type = VALUE_NULL, .len = 0};
+    switch (parser->current.type)
     {
-        case TOKEN_BEGIN_OBJECT: parse_object(); return;
-        case TOKEN_BEGIN_ARRAY: parse_array(); return;
+        case TOKEN_BEGIN_OBJECT:
+        case TOKEN_BEGIN_ARRAY:
+            return parse_nested(parser);
         default:
-            report_parse_error("Tried to parse a JSON file but errd.");
-            return;
+            report_parse_error(parser, ERROR_NOT_A_DOCUMENT);
+            return value;
+    }
+}
+
+/*parses the document of len bytes, or the one on the tape when it is not NULL*/
+static Value run_parser(Parser *parser, const char *source, const size_t len, const TokenTape *tape, Arena *arena,
+                        const SaxHandler *sax, void *sax_context)
+{
+    parser->had_error = false;
+    parser->panic_mode = false;
+    parser->error = NULL;
+    parser->error_line = 0;
+    parser->arena = arena;
+    parser->stack.len = 0;
+    parser->depth = 0;
+    parser->sax = sax;
+    parser->sax_context = sax_context;
+    parser->stopped = false;
+    parser->tape = tape;
+    parser->tape_next = 0;
+    if (tape != NULL) { parser->current = next_tape_token(parser); }
+    else
+    {
+        init_scanner(&parser->scanner, source, len);
+        parser->current = scan_token(&parser->scanner);
+    }
+    parser->previous = parser->current;
+
+    Value root = start_parse(parser);
+
+    if (!match(parser, TOKEN_EOF))
+    {
+        report_parse_error(parser, ERROR_EXTRA_DATA);
     }
+
+    return root;
+}
+
+void init_parser(Parser *parser)
+{
+    parser->stack.data = NULL;
+    parser->stack.len = 0;
+    parser->stack.capacity = 0;
+    parser->nesting = NULL;
+    parser->depth = 0;
+    parser->nesting_capacity = 0;
+    parser->max_depth = PARSER_MAX_DEPTH;
+}
+
+void free_parser(Parser *parser)
+{
+    free(parser->stack.data);
+    free(parser->nesting);
+    const size_t max_depth = parser->max_depth;
+    init_parser(parser);
+    parser->max_depth = max_depth;
 }
 
-const bool parse(const char *source)
+const bool parse(Parser *parser, const char *source, const size_t len)
 {
-    parser.had_error = false;
-    parser.panic_mode = false;
-    init_scanner(source);
-    parser.current = scan_token();
-    parser.previous = parser.current;
+    run_parser(parser, source, len, NULL, NULL, NULL, NULL);
+    return !parser->had_error;
+}
 
-    start_parse();
+/*the document model of the document of len bytes, or of the one on the tape when it is not NULL*/
+static Document *build_document(Parser *parser, const char *source, const size_t len, const TokenTape *tape)
+{
+    // a document model is usually about as big as its source, start the arena there
+    Arena arena;
+    init_arena(&arena, len);
+    Document *document = (Document *)arena_alloc(&arena, sizeof(Document));
+    if (document == NULL) { return NULL; }
 
-    if (!match(TOKEN_EOF))
+    document->root = run_parser(parser, source, len, tape, &arena, NULL, NULL);
+    if (parser->had_error)
     {
-        report_parse_error("Found extra data in the file.");
+        free_arena(&arena);
+        return NULL;
     }
+    document->arena = arena; // the arena owns the document, it is copied in last
+    return document;
+}
+
+Document *parse_document(Parser *parser, const char *source, const size_t len)
+{
+    return build_document(parser, source, len, NULL);
+}
+
+const bool parse_sax(Parser *parser, const char *source, const size_t len, const SaxHandler *handler, void *context)
+{
+    run_parser(parser, source, len, NULL, NULL, handler, context);
+    return !parser->had_error;
+}
+
+const bool parse_tape(Parser *parser, const TokenTape *tape)
+{
+    run_parser(parser, tape->source, tape->len, tape, NULL, NULL, NULL);
+    return !parser->had_error;
+}
+
+Document *parse_tape_document(Parser *parser, const TokenTape *tape)
+{
+    return build_document(parser, tape->source, tape->len, tape);
+}
+
+void free_document(Document *document)
+{
+    if (document == NULL) { return; }
+    Arena arena = document->arena;
+    free_arena(&arena);
+}
 
-    return !parser.had_error;
-}
\ No newline at end of file
+const Value *object_get(const Value *object, const char *key)
+{
+    if (object == NULL || object->type != VALUE_OBJECT) { return NULL; }
+    const size_t key_len = strlen(key);
+    for (unsigned int i = 0; i < object->len; i++)
+    {
+        const Member *member = &object->members[i];
+        if (member->key_len == key_len && memcmp(member->key, key, key_len) == 0) { return &member->value; }
+    }
+    return NULL;
+}
@@ -3,6 +3,185 @@
 
 #include <stdbool.h>
 
-const bool parse(const char *source);
+#include "json_arena.h"
+#include "json_scanner.h"
+#include "json_tape.h"
 
-#endif
\ No newline at end of file
+/*The types of values in a JSON document*/
+typedef enum
+{
+    VALUE_OBJECT,
+    VALUE_ARRAY,
+    VALUE_STRING,
+    VALUE_NUMBER,
+    VALUE_TRUE,
+    VALUE_FALSE,
+    VALUE_NULL
+} ValueType;
+
+typedef struct Value Value;
+typedef struct Member Member;
+
+/********************************************************************************
+ * A value in the document model. len is the number of members of an object, the
+ * number of values in an array, the length of a string (after unescaping), or
+ * the length of a numbers lexeme. A string without escapes points into the
+ * source, only one with escapes is unescaped into the arena, so strings are
+ * not NUL terminated and len is their length. A number keeps its lexeme as
+ * written next to its double value.
+ ********************************************************************************/
+struct Value
+{
+    ValueType type;
+    unsigned int len;
+    union
+    {
+        Member *members;
+        Value *values;
+        const char *string;
+        const char *lexeme;
+    };
+    double number;
+};
+
+/*an object member, the key is key_len bytes like a string value*/
+struct Member
+{
+    const char *key;
+    unsigned int key_len;
+    Value value;
+};
+
+/*A parsed document, every value and string in it is allocated from its arena*/
+typedef struct
+{
+    Arena arena;
+    Value root;
+} Document;
+
+/********************************************************************************
+ * The events of a document in the order they are in it, for going through a
+ * document without building anything. Every slice points into the source, no
+ * copy is made and nothing is allocated: a key or string is what is between
+ * its quotes with the escapes as written, a number is its lexeme.
+ * Every callback is optional, and returning false stops the parse. The events
+ * stop at the first error, so the events of an invalid document are only the
+ * ones before the error.
+ ********************************************************************************/
+typedef struct
+{
+    bool (*start_object)(void *context);
+    bool (*end_object)(void *context);
+    bool (*start_array)(void *context);
+    bool (*end_array)(void *context);
+    bool (*key)(void *context, const char *key, const size_t len);
+    bool (*string)(void *context, const char *string, const size_t len);
+    bool (*number)(void *context, const char *lexeme, const size_t len);
+    bool (*boolean)(void *context, const bool value);
+    bool (*null)(void *context);
+} SaxHandler;
+
+/********************************************************************************
+ * When the parser builds a document, the values of the objects and arrays that
+ * are still open are kept on a scratch stack. When an object or array ends its
+ * members or values are on the top of the stack, they are copied into the
+ * arena as one array and popped, so every object and array is a single
+ * allocation of exactly the right size.
+ ********************************************************************************/
+typedef struct
+{
+    char *data;
+    size_t len;
+    size_t capacity;
+} Stack;
+
+/*the deepest objects and arrays can be nested by default*/
+#define PARSER_MAX_DEPTH 1024
+
+/*the grammar errors, parse, the stream parser and the lazy parser report the same ones for the same input*/
+#define ERROR_NOT_A_DOCUMENT "Tried to parse a JSON file but errd."
+#define ERROR_EXPECTED_STRING "Tried to parse a string and didnt find one."
+#define ERROR_EXPECTED_NAME_SEPARATOR "Tried to parse a name separator but didnt find one."
+#define ERROR_EXPECTED_VALUE "Tried to parse a value but non was found."
+#define ERROR_EXPECTED_OBJECT_END "Expected '}' to end an object or ',' to separate members."
+#define ERROR_EXPECTED_ARRAY_END "Expected ']' to end an array or ',' to separate values."
+#define ERROR_TOO_DEEP "Objects and arrays are nested too deep."
+#define ERROR_EXTRA_DATA "Found extra data in the file."
+
+/********************************************************************************
+ * The Parser holds all the state of a parse, including its scanner. It is owned
+ * by the caller, so documents can be parsed on many threads at once with one
+ * parser per thread. A parser can parse any number of documents one after the
+ * other, the scratch stack is kept between them.
+ * The parser doesn't recurse, the objects and arrays that are open are kept in
+ * nesting, a word each: where their items start on the scratch stack and
+ * whether it is an object. max_depth is the deepest they can be nested, a
+ * document nested deeper is an error. It is PARSER_MAX_DEPTH after
+ * init_parser, and can be set to anything before a parse.
+ * The tokens come from the scanner, or from a token tape that was filled
+ * before, tape_next is then the next entry to read.
+ ********************************************************************************/
+typedef struct
+{
+    Scanner scanner;
+    const TokenTape *tape; // NULL when the tokens are scanned as they are parsed
+    size_t tape_next;
+    Token previous;
+    Token current;
+    bool had_error;
+    bool panic_mode;
+    const char *error; // the first error and its line, NULL if there was none
+    unsigned int error_line;
+    Arena *arena; // NULL when only validating
+    Stack stack;
+    size_t *nesting;
+    size_t depth;
+    size_t nesting_capacity;
+    size_t max_depth;
+    const SaxHandler *sax; // NULL when there are no events to hand out
+    void *sax_context;
+    bool stopped; // a sax callback returned false
+} Parser;
+
+/*initializes a parser, must be called before its first parse*/
+void init_parser(Parser *parser);
+
+/*frees the memory the parser kept between parses, the documents it built are not touched*/
+void free_parser(Parser *parser);
+
+/*validates the JSON document of len bytes without building anything, it doesn't have to be NUL terminated*/
+const bool parse(Parser *parser, const char *source, const size_t len);
+
+/********************************************************************************
+ * parses the JSON document of len bytes into a document model, it doesn't have
+ * to be NUL terminated. Returns NULL if the document
+ * is not valid JSON (or out of memory). The document is released with
+ * free_document, which frees every value in it at once. The document doesn't
+ * depend on the parser, it can be kept after the parser is freed, but its
+ * strings and number lexemes point into the source, which has to be kept as
+ * long as the document.
+ ********************************************************************************/
+Document *parse_document(Parser *parser, const char *source, const size_t len);
+
+/********************************************************************************
+ * hands the events of the JSON document of len bytes to the handler while it is
+ * validated. Returns true if the document is valid, and false if it is not or
+ * the handler stopped it, the error is then "Stopped by the handler.".
+ ********************************************************************************/
+const bool parse_sax(Parser *parser, const char *source, const size_t len, const SaxHandler *handler, void *context);
+
+/********************************************************************************
+ * parse and parse_document with the tokens of a tape (see json_tape.h) instead
+ * of the scanner, a document tokenized once can be parsed many times. The tape
+ * and its source have to be kept as long as the document.
+ ********************************************************************************/
+const bool parse_tape(Parser *parser, const TokenTape *tape);
+Document *parse_tape_document(Parser *parser, const TokenTape *tape);
+
+/*frees the document and all of its values*/
+void free_document(Document *document);
+
+/*returns the value of the first member named key, or NULL if the value is not an object or has no such member*/
+const Value *object_get(const Value *object, const char *key);
+
+#endif
@@ -5,44 +5,117 @@
 #include <stdio.h>
 
 #include "json_scanner.h"
+#include "json_utf8.h"
 
 /********************************************************************************
- * The Scanner keeps track of which character in the JSON document the scanner
- * is currently on and on which line.
+ * the class of every char, for the first char of a token. A symbol is its own
+ * token, a digit or '-' starts a number, t, f, and n start the keywords, any
+ * other letter an invalid keyword, and the rest can't start a token at all.
  ********************************************************************************/
-typedef struct
+typedef enum
 {
-    const char *start;
-    const char *current;
-    unsigned int line;
-} Scanner;
+    CHAR_OTHER,
+    CHAR_WHITESPACE,
+    CHAR_BEGIN_OBJECT,
+    CHAR_END_OBJECT,
+    CHAR_BEGIN_ARRAY,
+    CHAR_END_ARRAY,
+    CHAR_NAME_SEPARATOR,
+    CHAR_VALUE_SEPARATOR,
+    CHAR_QUOTE,
+    CHAR_MINUS,
+    CHAR_DIGIT,
+    CHAR_TRUE,
+    CHAR_FALSE,
+    CHAR_NULL,
+    CHAR_ALPHA
+} CharClass;
 
-/*global scanner for the JSON documnet*/
-Scanner scanner;
+#define XX CHAR_OTHER
+#define WS CHAR_WHITESPACE
+#define BO CHAR_BEGIN_OBJECT
+#define EO CHAR_END_OBJECT
+#define BA CHAR_BEGIN_ARRAY
+#define EA CHAR_END_ARRAY
+#define NS CHAR_NAME_SEPARATOR
+#define VS CHAR_VALUE_SEPARATOR
+#define QU CHAR_QUOTE
+#define MI CHAR_MINUS
+#define DI CHAR_DIGIT
+#define TR CHAR_TRUE
+#define FA CHAR_FALSE
+#define NU CHAR_NULL
+#define AL CHAR_ALPHA
+
+static const unsigned char char_class[256] = {
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, WS, WS, XX, XX, WS, XX, XX, // 0x00
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, // 0x10
+    WS, XX, QU, XX, XX, XX, XX, XX, XX, XX, XX, XX, VS, MI, XX, XX, // 0x20  !"#$%&'()*+,-./
+    DI, DI, DI, DI, DI, DI, DI, DI, DI, DI, NS, XX, XX, XX, XX, XX, // 0x30 0123456789:;<=>?
+    XX, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, // 0x40 @ABCDEFGHIJKLMNO
+    AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, BA, XX, EA, XX, XX, // 0x50 PQRSTUVWXYZ[\]^_
+    XX, AL, AL, AL, AL, AL, FA, AL, AL, AL, AL, AL, AL, AL, NU, AL, // 0x60 `abcdefghijklmno
+    AL, AL, AL, AL, TR, AL, AL, AL, AL, AL, AL, BO, XX, EO, XX, XX, // 0x70 pqrstuvwxyz{|}~
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, // 0x80
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, // 0x90
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, // 0xa0
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, // 0xb0
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, // 0xc0
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, // 0xd0
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, // 0xe0
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, // 0xf0
+};
+
+#undef XX
+#undef WS
+#undef BO
+#undef EO
+#undef BA
+#undef EA
+#undef NS
+#undef VS
+#undef QU
+#undef MI
+#undef DI
+#undef TR
+#undef FA
+#undef NU
+#undef AL
+
+static CharClass class_of(const char c)
+{
+    return (CharClass)char_class[(unsigned char)c];
+}
 
 /*initializes the scanner to the start of the JSON document and the first line*/
-void init_scanner(const char *source)
+void init_scanner(Scanner *scanner, const char *source, const size_t len)
 {
-    scanner.start = source;
-    scanner.current = source;
-    scanner.line = 1;
+    scanner->source = source;
+    scanner->end = source + len;
+    scanner->start = source;
+    scanner->current = source;
+    scanner->line = 1;
+    scanner->next = 0;
+    init_index(&scanner->index, source, scanner->end - source);
 }
 
-static const char peek()
+/*the current char, or '\0' past the end, the document doesn't have to be NUL terminated*/
+static const char peek(Scanner *scanner)
 {
-    return *scanner.current;
+    return scanner->current < scanner->end ? *scanner->current : '\0';
 }
 
-static const bool is_at_end()
+/*the end is the length of the document, a NUL in it is just a character that is not valid JSON*/
+static const bool is_at_end(Scanner *scanner)
 {
-    return *scanner.current == '\0';
+    return scanner->current >= scanner->end;
 }
 
 /*advances the scanner one char and return the previous char*/
-static const char advance()
+static const char advance(Scanner *scanner)
 {
-    scanner.current++;
-    return scanner.current[-1];
+    scanner->current++;
+    return scanner->current[-1];
 }
 
 /*digits = [0 - 9]*/
@@ -62,64 +135,117 @@ static const bool is_exponent(const char c)
     return c == 'e' || c == 'E';
 }
 
+/*letters = [a - z] and [A - Z]*/
 static const bool is_alpha(const char c)
 {
-    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+    return class_of(c) >= CHAR_TRUE;
 }
 
 /*whitespaces = newline, tab, space, and return*/
-static void consume_whitespaces()
+static const bool is_whitespace(const char c)
+{
+    return class_of(c) == CHAR_WHITESPACE;
+}
+
+/********************************************************************************
+ * moves the scanner to the start of the next token. When the last token ended
+ * right before another token (no whitespace between them) the scanner is
+ * already there, otherwise it jumps to the next entry of the index and takes
+ * the line from it. Past the last entry there is only whitespace left.
+ ********************************************************************************/
+static void skip_to_token(Scanner *scanner)
 {
+    StructuralIndex *index = &scanner->index;
     for (;;)
     {
-        switch (peek())
+        if (scanner->next == index->count)
+        {
+            scanner->next = 0;
+            if (next_window(index)) { continue; }
+            if (is_whitespace(peek(scanner)))
+            {
+                scanner->current = scanner->end;
+                scanner->line = index->line;
+            }
+            return;
+        }
+        const char *entry = scanner->source + index->base + index->positions[scanner->next];
+        if (entry < scanner->current)
         {
-            case '\n': scanner.line++;
-            case ' ':
-            case '\t':
-            case '\r':
-                advance();
-                break;
-            default:
-                return;
+            scanner->next++; // inside a token that was already scanned
+            continue;
         }
+        if (entry == scanner->current)
+        {
+            scanner->next++;
+            return;
+        }
+        if (!is_whitespace(peek(scanner))) { return; }
+        scanner->current = entry;
+        scanner->line = index_line(index, index->positions[scanner->next]);
+        scanner->next++;
+        return;
     }
 }
 
-/********************************************************************************
- * creates a token with the information from the scanner. If the token is an
- * error token the error message is sent as a parameter. This is so the scanner
- * can also highlight the code snippet.
- ********************************************************************************/
-static Token make_token(const TokenType type, const char *message)
+/*creates a token with the information from the scanner, a token that is not an error has an empty message*/
+static Token make_token(Scanner *scanner, const TokenType type)
 {
     Token token = {
         .type = type,
-        .start = scanner.start,
-        .len = scanner.current - scanner.start,
-        .message = message,
-        .msg_len = strlen(message),
-        .line = scanner.line
+        .start = scanner->start,
+        .len = scanner->current - scanner->start,
+        .message = "",
+        .msg_len = 0,
+        .line = scanner->line
     };
     return token;
 }
 
+/********************************************************************************
+ * creates an error token with its message. This is so the scanner can also
+ * highlight the code snippet. The messages are string literals, ERROR_TOKEN
+ * takes their length from sizeof instead of counting it for every token.
+ ********************************************************************************/
+static Token make_error_token(Scanner *scanner, const char *message, const unsigned int msg_len)
+{
+    Token token = make_token(scanner, TOKEN_ERROR);
+    token.message = message;
+    token.msg_len = msg_len;
+    return token;
+}
+
+#define ERROR_TOKEN(scanner, message) make_error_token(scanner, "" message, sizeof(message) - 1)
+
 /*fraction = .digit *(digit)*/
-static const bool fraction()
+static const bool fraction(Scanner *scanner)
 {
-    advance();
-    if (!is_digit(peek())) { return false; }
-    while (is_digit(peek())) { advance(); }
+    advance(scanner);
+    if (!is_digit(peek(scanner))) { return false; }
+    NumberParts *number = &scanner->number;
+    const char *digits = scanner->current;
+    while (is_digit(peek(scanner))) { number->mantissa = number->mantissa * 10 + (advance(scanner) - '0'); }
+    number->digits += scanner->current - digits;
+    number->exponent -= scanner->current - digits;
+    number->integer = false;
     return true;
 }
 
-/*exponent = e|E (+|-) digit *(digit)*/
-static const bool exponent()
+/*exponent = e|E (+|-) digit *(digit), the value stops growing far past where every double is 0 or infinity*/
+static const bool exponent(Scanner *scanner)
 {
-    advance();
-    if (peek() == '-' || peek() == '+') { advance(); }
-    if (!is_digit(peek())) { return false; }
-    while (is_digit(peek())) { advance(); }
+    advance(scanner);
+    const bool negative = peek(scanner) == '-';
+    if (peek(scanner) == '-' || peek(scanner) == '+') { advance(scanner); }
+    if (!is_digit(peek(scanner))) { return false; }
+    int64_t value = 0;
+    while (is_digit(peek(scanner)))
+    {
+        const char c = advance(scanner);
+        if (value < 1000000) { value = value * 10 + (c - '0'); }
+    }
+    scanner->number.exponent += negative ? -value : value;
+    scanner->number.integer = false;
     return true;
 }
 
@@ -127,20 +253,31 @@ static const bool exponent()
  * number = 0|[1 - 9] *(digit) with optional fraction and/or optional exponent
  * fraction = .digit *(digit)
  * exponent =  e|E (+|-) difit *(digit)
+ * The digits are added to the mantissa of the number as they are read, so the
+ * parser gets its value without reading them again. A number with more digits
+ * than the mantissa holds is read again from its lexeme (see json_number.h).
  ********************************************************************************/
-static Token number(const char c)
+static Token number(Scanner *scanner, const char c, const bool negative)
 {
-    if (c == '0' && is_digit(peek())) { return make_token(TOKEN_ERROR, "Whole part of number can't have leading zeroes."); }
-    while (is_digit(peek())) { advance(); }
-    if (peek() == '.') // has fraction
+    if (c == '0' && is_digit(peek(scanner))) { return ERROR_TOKEN(scanner, "Whole part of number can't have leading zeroes."); }
+    NumberParts *number = &scanner->number;
+    const char *digits = scanner->current - 1;
+    number->mantissa = c - '0';
+    while (is_digit(peek(scanner))) { number->mantissa = number->mantissa * 10 + (advance(scanner) - '0'); }
+    number->digits = scanner->current - digits;
+    number->exponent = 0;
+    number->negative = negative;
+    number->integer = true;
+    number->truncated = false;
+    if (peek(scanner) == '.') // has fraction
     {
-        if (!fraction()) { return make_token(TOKEN_ERROR, "need at least one digit for fraction."); }
+        if (!fraction(scanner)) { return ERROR_TOKEN(scanner, "need at least one digit for fraction."); }
     }
-    if (is_exponent(peek())) // has exponent
+    if (is_exponent(peek(scanner))) // has exponent
     {
-        if (!exponent()) { return make_token(TOKEN_ERROR, "need at least one digit for exponent."); }
+        if (!exponent(scanner)) { return ERROR_TOKEN(scanner, "need at least one digit for exponent."); }
     }
-    return make_token(TOKEN_NUMBER, "");
+    return make_token(scanner, TOKEN_NUMBER);
 }
 
 /********************************************************************************
@@ -149,43 +286,45 @@ static Token number(const char c)
  * fraction = .digit *(digit)
  * exponent =  e|E (+|-) digit *(digit)
  ********************************************************************************/
-static Token negative_number()
+static Token negative_number(Scanner *scanner)
 {
-    if (is_digit(peek())) return number(advance());
-    return make_token(TOKEN_ERROR, "Negative witout a number.");
+    if (is_digit(peek(scanner))) return number(scanner, advance(scanner), true);
+    return ERROR_TOKEN(scanner, "Negative witout a number.");
 }
 
-static const bool match(const int start, const char* rest, const int len)
+static const bool match(Scanner *scanner, const char *word, const int len)
 {
-    return ((scanner.current - scanner.start) == (start + len)) && memcmp(scanner.start + start, rest, len) == 0;
+    return scanner->current - scanner->start == len && memcmp(scanner->start, word, len) == 0;
 }
 
-/*keywords = false, true, and null*/
-static Token keyword()
+/*keywords = false, true, and null, the class of the first letter picked the keyword, any other letter starts none*/
+static Token keyword(Scanner *scanner, const CharClass class)
 {
-    while (is_alpha(peek())) advance(); // advance until a non-letter is reached
-    switch (scanner.start[0])
+    while (is_alpha(peek(scanner))) advance(scanner); // advance until a non-letter is reached
+    switch (class)
     {
-        case 'f':
-            if (match(1, "alse", 4)) { return make_token(TOKEN_FALSE, ""); }
+        case CHAR_TRUE:
+            if (match(scanner, "true", 4)) { return make_token(scanner, TOKEN_TRUE); }
             break;
-        case 't':
-            if (match(1, "rue", 3)) { return make_token(TOKEN_TRUE, ""); }
+        case CHAR_FALSE:
+            if (match(scanner, "false", 5)) { return make_token(scanner, TOKEN_FALSE); }
+            break;
+        case CHAR_NULL:
+            if (match(scanner, "null", 4)) { return make_token(scanner, TOKEN_NULL); }
+            break;
+        default:
             break;
-        case 'n':
-        if (match(1, "ull", 3)) { return make_token(TOKEN_NULL, ""); }
-        break;
     }
-    return make_token(TOKEN_ERROR, "Invalid keyword.");
+    return ERROR_TOKEN(scanner, "Invalid keyword.");
 }
 
 /********************************************************************************
  * escaped = ", \, /, b, f, n, r, t, and uXXXX where x is a hex digit. This
  * allows unicode characters to be entered by their hex value.
  ********************************************************************************/
-static const bool escaped()
+static const bool escaped(Scanner *scanner)
 {
-    switch (peek())
+    switch (peek(scanner))
     {
         case '\\':
         case '"':
@@ -199,8 +338,8 @@ static const bool escaped()
         case 'u':
             for (int i = 0; i < 4; i++)
             {
-                advance();
-                if (!is_hex(peek())) { return false; }
+                advance(scanner);
+                if (!is_hex(peek(scanner))) { return false; }
             }
             return true;
     }
@@ -212,20 +351,67 @@ static const bool escaped()
  * characters = unicode characters >= 0x20 excluding the \ and " characters.
  * escaped = ", \, /, b, f, n, r, t, and uXXXX where x is a hex digit. This
  * allows unicode characters to be entered by their hex value.
+ * Only the quotes, backslashes, and control characters need a look, the
+ * scanner jumps from one to the next with the index. A string that runs past
+ * the window goes on in the next one, the window has no entries left after the
+ * opening quote. The index has checked the utf-8 of the windows, the string is
+ * valid unless the first error is in it.
+ * Past the end of the index the string is scanned one char at a time.
  ********************************************************************************/
-static Token string()
+static Token string(Scanner *scanner)
 {
-    while (!(peek() == '"') && !(is_at_end())) {
-        if (peek() < 32) { return make_token(TOKEN_ERROR, "Not a valid character in string."); }
-        if (peek() == '\\') {
-            advance();
-            if (!escaped()) { return make_token(TOKEN_ERROR, "Invalid escaped character."); }
+    scanner->escaped = false;
+    StructuralIndex *index = &scanner->index;
+    while (scanner->current >= scanner->source + index->base)
+    {
+        const char *window = scanner->source + index->base;
+        const long stop = next_string_stop(index, scanner->current - window);
+        if (stop < 0)
+        {
+            if (scanner->next != index->count) { break; }
+            const char *indexed = scanner->source + index->indexed;
+            if (scanner->current < indexed) { scanner->current = indexed; } // an escape can end past the window
+            scanner->next = 0;
+            if (!next_window(index)) { break; }
+            continue;
+        }
+        scanner->current = window + stop;
+        if (peek(scanner) == '"')
+        {
+            advance(scanner); // move past the closing '"'
+            const size_t invalid = index->invalid_utf8;
+            if (invalid >= (size_t)(scanner->start - scanner->source) && invalid < (size_t)(scanner->current - scanner->source))
+            {
+                return ERROR_TOKEN(scanner, "Invalid UTF-8 in string.");
+            }
+            return make_token(scanner, TOKEN_STRING);
+        }
+        if (peek(scanner) != '\\') { return ERROR_TOKEN(scanner, "Not a valid character in string."); }
+        advance(scanner);
+        if (!escaped(scanner)) { return ERROR_TOKEN(scanner, "Invalid escaped character."); }
+        advance(scanner);
+        scanner->escaped = true;
+    }
+
+    while (!(peek(scanner) == '"') && !(is_at_end(scanner))) {
+        if ((unsigned char)peek(scanner) < 32) { return ERROR_TOKEN(scanner, "Not a valid character in string."); }
+        if ((unsigned char)peek(scanner) >= 0x80)
+        {
+            const unsigned int len = utf8_length((const unsigned char *)scanner->current, (const unsigned char *)scanner->end);
+            if (len == 0) { return ERROR_TOKEN(scanner, "Invalid UTF-8 in string."); }
+            scanner->current += len;
+            continue;
         }
-        advance();
+        if (peek(scanner) == '\\') {
+            advance(scanner);
+            if (!escaped(scanner)) { return ERROR_TOKEN(scanner, "Invalid escaped character."); }
+            scanner->escaped = true;
+        }
+        advance(scanner);
     }
-    if (is_at_end()) { return make_token(TOKEN_ERROR, "Reached end of file without a string terminator."); }
-    advance(); // move past the closing '"'
-    return make_token(TOKEN_STRING, "");
+    if (is_at_end(scanner)) { return ERROR_TOKEN(scanner, "Reached end of file without a string terminator."); }
+    advance(scanner); // move past the closing '"'
+    return make_token(scanner, TOKEN_STRING);
 }
 
 /********************************************************************************
@@ -234,27 +420,66 @@ static Token string()
  * Each token holds the information of where in the document the tokens lexeme
  * is and the length. If there was an error the token also contains a message
  * related to the error.
+ * The class of the first char (one lookup in char_class) picks the token, the
+ * switch over the classes is a jump table.
  ********************************************************************************/
-Token scan_token()
+Token scan_token(Scanner *scanner)
 {
-    consume_whitespaces();
-    if (is_at_end()) { return make_token(TOKEN_EOF, ""); }
-    scanner.start = scanner.current;
-    const char c = advance();
+    skip_to_token(scanner);
+    if (is_at_end(scanner)) { return make_token(scanner, TOKEN_EOF); }
+    scanner->start = scanner->current;
+    const char c = advance(scanner);
 
-    if (is_digit(c)) { return number(c); }
-    if (is_alpha(c)) { return keyword(); }
+    const CharClass class = class_of(c);
+    switch (class)
+    {
+        case CHAR_BEGIN_OBJECT: return make_token(scanner, TOKEN_BEGIN_OBJECT);
+        case CHAR_END_OBJECT: return make_token(scanner, TOKEN_END_OBJECT);
+        case CHAR_BEGIN_ARRAY: return make_token(scanner, TOKEN_BEGIN_ARRAY);
+        case CHAR_END_ARRAY: return make_token(scanner, TOKEN_END_ARRAY);
+        case CHAR_NAME_SEPARATOR: return make_token(scanner, TOKEN_NAME_SEPARATOR);
+        case CHAR_VALUE_SEPARATOR: return make_token(scanner, TOKEN_VALUE_SEPARATOR);
+        case CHAR_QUOTE: return string(scanner);
+        case CHAR_MINUS: return negative_number(scanner);
+        case CHAR_DIGIT: return number(scanner, c, false);
+        case CHAR_TRUE:
+        case CHAR_FALSE:
+        case CHAR_NULL:
+        case CHAR_ALPHA:
+            return keyword(scanner, class);
+        default: return ERROR_TOKEN(scanner, "Unrecognized character.");
+    }
+}
 
-    switch (c)
+/********************************************************************************
+ * moves the scanner past the end of the object or array the last token began,
+ * without scanning the tokens in it. Only the '{' '[' '}' and ']' entries of
+ * the index are counted, the strings in it are not in the index at all. What
+ * is in it is not checked, a '}' ends a '[' as well. Returns false if the
+ * document ends before it does.
+ ********************************************************************************/
+bool skip_nested(Scanner *scanner)
+{
+    StructuralIndex *index = &scanner->index;
+    size_t depth = 1;
+    for (;;)
     {
-        case '{': return make_token(TOKEN_BEGIN_OBJECT, "");
-        case '}': return make_token(TOKEN_END_OBJECT, "");
-        case '[': return make_token(TOKEN_BEGIN_ARRAY, "");
-        case ']': return make_token(TOKEN_END_ARRAY, "");
-        case ':': return make_token(TOKEN_NAME_SEPARATOR, "");
-        case ',': return make_token(TOKEN_VALUE_SEPARATOR, "");
-        case '-': return negative_number(c);
-        case '"': return string();
+        if (scanner->next == index->count)
+        {
+            scanner->next = 0;
+            if (next_window(index)) { continue; }
+            scanner->current = scanner->end;
+            return false;
+        }
+        const uint32_t position = index->positions[scanner->next++];
+        const char *entry = scanner->source + index->base + position;
+        if (entry < scanner->current) { continue; }
+        if (*entry == '{' || *entry == '[') { depth++; }
+        else if ((*entry == '}' || *entry == ']') && --depth == 0)
+        {
+            scanner->current = entry + 1;
+            scanner->line = index_line(index, position);
+            return true;
+        }
     }
-    return make_token(TOKEN_ERROR, "Unrecognized character.");
-}
\ No newline at end of file
+}
@@ -1,6 +1,12 @@
 #ifndef JSON_SCANNER_H
 #define JSON_SCANNER_H
 
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "json_index.h"
+#include "json_number.h"
+
 /*All the tokens that can be created when parsing a JSON file*/
 typedef enum
 {
@@ -35,10 +41,39 @@ typedef struct
     unsigned int line;
 } Token;
 
+/********************************************************************************
+ * The Scanner keeps track of which character in the JSON document the scanner
+ * is currently on and on which line.
+ * The document is indexed a window at a time (see json_index.h), between tokens
+ * the scanner jumps straight to the next entry of the index instead of reading
+ * the whitespace. next is the first entry of the window that has not been
+ * reached yet.
+ * number holds the parts of the last number token, read as it was scanned,
+ * and escaped is set if the last string token has an escape in it.
+ * The scanner is owned by the caller and holds all of its state, so any number
+ * of documents can be scanned at once, one scanner per document (and thread).
+ ********************************************************************************/
+typedef struct
+{
+    const char *source;
+    const char *end;
+    const char *start;
+    const char *current;
+    unsigned int line;
+    StructuralIndex index;
+    size_t next;
+    NumberParts number;
+    bool escaped;
+} Scanner;
+
 /*function prototypes for interfacing with the json_scanner*/
 
-/*initializes the scanner to the start of the JSON document and the first line*/
-void init_scanner(const char *source);
+/********************************************************************************
+ * initializes the scanner to the start of the JSON document of len bytes and the
+ * first line. The document doesn't need a NUL at the end and the scanner never
+ * reads past it, so it can scan a memory mapped file in place.
+ ********************************************************************************/
+void init_scanner(Scanner *scanner, const char *source, const size_t len);
 
 /********************************************************************************
  * scans a single token and creates a token struct to return to the caller
@@ -47,6 +82,13 @@ void init_scanner(const char *source);
  * is and the length. If there was an error the token also contains a message
  * related to the error.
  ********************************************************************************/
-Token scan_token();
+Token scan_token(Scanner *scanner);
+
+/********************************************************************************
+ * skips to the end of the object or array the last token began, the brackets
+ * of the index are counted without scanning anything in it, nothing in it is
+ * checked. Returns false if the document ends first.
+ ********************************************************************************/
+bool skip_nested(Scanner *scanner);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,490 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "json_parser.h"
+#include "json_stream.h"
+#include "json_utf8.h"
+
+/********************************************************************************
+ * where in a token the last chunk ended, the hex states count down the digits
+ * of a \uXXXX escape and the utf8 states the continuation bytes of a character
+ ********************************************************************************/
+typedef enum
+{
+    LEX_NONE, // between tokens
+    LEX_STRING,
+    LEX_ESCAPE,
+    LEX_HEX_4,
+    LEX_HEX_3,
+    LEX_HEX_2,
+    LEX_HEX_1,
+    LEX_UTF8_3,
+    LEX_UTF8_2,
+    LEX_UTF8_1,
+    LEX_MINUS,
+    LEX_ZERO,
+    LEX_INTEGER,
+    LEX_DOT,
+    LEX_FRACTION,
+    LEX_EXPONENT_START,
+    LEX_EXPONENT_SIGN,
+    LEX_EXPONENT,
+    LEX_KEYWORD
+} LexState;
+
+/*the tokens the grammar allows next*/
+typedef enum
+{
+    EXPECT_ROOT,
+    EXPECT_FIRST_KEY,   // a key or '}'
+    EXPECT_KEY,
+    EXPECT_NAME_SEPARATOR,
+    EXPECT_FIRST_VALUE, // a value or ']'
+    EXPECT_VALUE,
+    EXPECT_SEPARATOR,   // ',' or the end of the object or array that is open
+    EXPECT_EOF
+} Expect;
+
+void init_stream_parser(StreamParser *parser, TokenHandler on_token, void *context)
+{
+    parser->on_token = on_token;
+    parser->context = context;
+    parser->lex = LEX_NONE;
+    parser->expect = EXPECT_ROOT;
+    parser->nesting = NULL;
+    parser->depth = 0;
+    parser->nesting_capacity = 0;
+    parser->max_depth = PARSER_MAX_DEPTH;
+    parser->pending = NULL;
+    parser->pending_len = 0;
+    parser->pending_capacity = 0;
+    parser->split = false;
+    parser->word_len = 0;
+    parser->line = 1;
+    parser->error = NULL;
+}
+
+void free_stream_parser(StreamParser *parser)
+{
+    free(parser->nesting);
+    free(parser->pending);
+    parser->nesting = NULL;
+    parser->pending = NULL;
+    parser->nesting_capacity = 0;
+    parser->pending_capacity = 0;
+}
+
+static bool fail(StreamParser *parser, const char *message)
+{
+    parser->error = message;
+    return false;
+}
+
+/*digits = [0 - 9]*/
+static bool is_digit(const char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+/* hex digits = [0 - F] case insensitive*/
+static bool is_hex(const char c)
+{
+    return is_digit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+static bool is_alpha(const char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+/*whitespaces = newline, tab, space, and return*/
+static bool is_whitespace(const char c)
+{
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r';
+}
+
+/*the characters that end a run of ascii characters in a string*/
+static bool is_string_stop(const char c)
+{
+    return c == '"' || c == '\\' || (unsigned char)c < 32 || (unsigned char)c >= 0x80;
+}
+
+/*appends the part of a split token that is in this chunk to pending*/
+static bool keep(StreamParser *parser, const char *data, const size_t len)
+{
+    if (len == 0) { return true; }
+    if (parser->pending_len + len > parser->pending_capacity)
+    {
+        size_t capacity = parser->pending_capacity == 0 ? 256 : parser->pending_capacity * 2;
+        while (capacity < parser->pending_len + len) { capacity *= 2; }
+        char *pending = (char *)realloc(parser->pending, capacity);
+        if (pending == NULL) { return fail(parser, "Out of memory."); }
+        parser->pending = pending;
+        parser->pending_capacity = capacity;
+    }
+    memcpy(parser->pending + parser->pending_len, data, len);
+    parser->pending_len += len;
+    return true;
+}
+
+static bool push_nesting(StreamParser *parser, const TokenType type)
+{
+    if (parser->depth == parser->max_depth) { return fail(parser, ERROR_TOO_DEEP); }
+    if (parser->depth == parser->nesting_capacity)
+    {
+        const size_t capacity = parser->nesting_capacity == 0 ? 64 : parser->nesting_capacity * 2;
+        char *nesting = (char *)realloc(parser->nesting, capacity);
+        if (nesting == NULL) { return fail(parser, "Out of memory."); }
+        parser->nesting = nesting;
+        parser->nesting_capacity = capacity;
+    }
+    parser->nesting[parser->depth++] = type;
+    parser->expect = type == TOKEN_BEGIN_OBJECT ? EXPECT_FIRST_KEY : EXPECT_FIRST_VALUE;
+    return true;
+}
+
+static bool pop_nesting(StreamParser *parser)
+{
+    parser->depth--;
+    parser->expect = parser->depth == 0 ? EXPECT_EOF : EXPECT_SEPARATOR;
+    return true;
+}
+
+/********************************************************************************
+ * checks the token against the grammar, the same one the parser follows:
+ * document = object | array
+ * object = { member *(, member) }, member = string: value
+ * array = [ value *(, value) ]
+ ********************************************************************************/
+static bool accept(StreamParser *parser, const TokenType type)
+{
+    switch (parser->expect)
+    {
+        case EXPECT_ROOT:
+            if (type != TOKEN_BEGIN_OBJECT && type != TOKEN_BEGIN_ARRAY) { return fail(parser, ERROR_NOT_A_DOCUMENT); }
+            return push_nesting(parser, type);
+        case EXPECT_FIRST_KEY:
+            if (type == TOKEN_END_OBJECT) { return pop_nesting(parser); }
+            // fall through
+        case EXPECT_KEY:
+            if (type != TOKEN_STRING) { return fail(parser, ERROR_EXPECTED_STRING); }
+            parser->expect = EXPECT_NAME_SEPARATOR;
+            return true;
+        case EXPECT_NAME_SEPARATOR:
+            if (type != TOKEN_NAME_SEPARATOR) { return fail(parser, ERROR_EXPECTED_NAME_SEPARATOR); }
+            parser->expect = EXPECT_VALUE;
+            return true;
+        case EXPECT_FIRST_VALUE:
+            if (type == TOKEN_END_ARRAY) { return pop_nesting(parser); }
+            // fall through
+        case EXPECT_VALUE:
+            if (type == TOKEN_BEGIN_OBJECT || type == TOKEN_BEGIN_ARRAY) { return push_nesting(parser, type); }
+            if (type < TOKEN_STRING || type > TOKEN_NULL) { return fail(parser, ERROR_EXPECTED_VALUE); }
+            parser->expect = EXPECT_SEPARATOR;
+            return true;
+        case EXPECT_SEPARATOR:
+        {
+            const bool in_object = parser->nesting[parser->depth - 1] == TOKEN_BEGIN_OBJECT;
+            if (type == TOKEN_VALUE_SEPARATOR)
+            {
+                parser->expect = in_object ? EXPECT_KEY : EXPECT_VALUE;
+                return true;
+            }
+            if (type == (in_object ? TOKEN_END_OBJECT : TOKEN_END_ARRAY)) { return pop_nesting(parser); }
+            if (in_object) { return fail(parser, ERROR_EXPECTED_OBJECT_END); }
+            return fail(parser, ERROR_EXPECTED_ARRAY_END);
+        }
+    }
+    return fail(parser, ERROR_EXTRA_DATA);
+}
+
+/********************************************************************************
+ * ends the token that started at start, or in an earlier chunk if it is split,
+ * and ended at end. A split token is put together in pending for the handler.
+ * An error token is handed over too and stops the parse.
+ ********************************************************************************/
+static bool end_token(StreamParser *parser, const TokenType type, const char *start, const char *end, const char *message)
+{
+    parser->lex = LEX_NONE;
+    if (parser->on_token == NULL)
+    {
+        parser->split = false;
+        if (type == TOKEN_ERROR) { return fail(parser, message); }
+        return accept(parser, type);
+    }
+
+    Token token = {.type = type, .start = start, .len = end - start, .message = message, .msg_len = strlen(message), .line = parser->line};
+    if (parser->split)
+    {
+        if (!keep(parser, start, end - start)) { return false; }
+        token.start = parser->pending;
+        token.len = parser->pending_len;
+        parser->pending_len = 0;
+        parser->split = false;
+    }
+    if (type == TOKEN_ERROR)
+    {
+        parser->on_token(parser->context, token);
+        return fail(parser, message);
+    }
+    if (!accept(parser, type)) { return false; }
+    parser->on_token(parser->context, token);
+    return true;
+}
+
+/********************************************************************************
+ * string = " *(characters|\escaped) "
+ * characters = unicode characters >= 0x20 excluding the \ and " characters.
+ * escaped = ", \, /, b, f, n, r, t, and uXXXX where x is a hex digit.
+ * The characters past ascii have to be valid utf-8, utf8_low and utf8_high
+ * are the range of the next continuation byte.
+ * Returns where the string or the chunk ended, or NULL on an error.
+ ********************************************************************************/
+static const char *string(StreamParser *parser, const char *start, const char *c, const char *end)
+{
+    while (c < end)
+    {
+        switch (parser->lex)
+        {
+            case LEX_STRING:
+                for (;;)
+                {
+                    while (c < end && !is_string_stop(*c)) { c++; }
+                    if (c == end) { return c; }
+                    // a whole character in the chunk is checked at once, one cut off by the chunk goes through the states
+                    const unsigned int len = (unsigned char)*c >= 0x80 ? utf8_length((const unsigned char *)c, (const unsigned char *)end) : 0;
+                    if (len == 0) { break; }
+                    c += len;
+                }
+                if (*c == '"') { return end_token(parser, TOKEN_STRING, start, c + 1, "") ? c + 1 : NULL; }
+                if ((unsigned char)*c >= 0x80)
+                {
+                    const unsigned int len = utf8_lead(*c, &parser->utf8_low, &parser->utf8_high);
+                    if (len == 0) { end_token(parser, TOKEN_ERROR, start, c, "Invalid UTF-8 in string."); return NULL; }
+                    parser->lex = LEX_UTF8_1 + 2 - len;
+                    break;
+                }
+                if (*c != '\\') { end_token(parser, TOKEN_ERROR, start, c, "Not a valid character in string."); return NULL; }
+                parser->lex = LEX_ESCAPE;
+                break;
+            case LEX_UTF8_3:
+            case LEX_UTF8_2:
+            case LEX_UTF8_1:
+                if ((unsigned char)*c < parser->utf8_low || (unsigned char)*c > parser->utf8_high)
+                {
+                    end_token(parser, TOKEN_ERROR, start, c, "Invalid UTF-8 in string.");
+                    return NULL;
+                }
+                parser->utf8_low = 0x80;
+                parser->utf8_high = 0xbf;
+                parser->lex = parser->lex == LEX_UTF8_1 ? LEX_STRING : parser->lex + 1;
+                break;
+            case LEX_ESCAPE:
+                switch (*c)
+                {
+                    case '\\':
+                    case '"':
+                    case '/':
+                    case 'b':
+                    case 'f':
+                    case 'n':
+                    case 'r':
+                    case 't':
+                        parser->lex = LEX_STRING;
+                        break;
+                    case 'u':
+                        parser->lex = LEX_HEX_4;
+                        break;
+                    default:
+                        end_token(parser, TOKEN_ERROR, start, c, "Invalid escaped character.");
+                        return NULL;
+                }
+                break;
+            default: // one of the hex digits
+                if (!is_hex(*c)) { end_token(parser, TOKEN_ERROR, start, c, "Invalid escaped character."); return NULL; }
+                parser->lex = parser->lex == LEX_HEX_1 ? LEX_STRING : parser->lex + 1;
+                break;
+        }
+        c++;
+    }
+    return c;
+}
+
+/********************************************************************************
+ * number = (-) 0|[1 - 9] *(digit) with optional fraction and/or optional exponent
+ * fraction = .digit *(digit)
+ * exponent = e|E (+|-) digit *(digit)
+ * A number ends at the first character that can't be part of it, so one that
+ * reaches the end of the chunk isn't done until the next chunk (or the end of
+ * the document). Returns where the number or the chunk ended, or NULL on an error.
+ ********************************************************************************/
+static const char *number(StreamParser *parser, const char *start, const char *c, const char *end)
+{
+    for (; c < end; c++)
+    {
+        const char d = *c;
+        switch (parser->lex)
+        {
+            case LEX_MINUS:
+                if (!is_digit(d)) { end_token(parser, TOKEN_ERROR, start, c, "Negative witout a number."); return NULL; }
+                parser->lex = d == '0' ? LEX_ZERO : LEX_INTEGER;
+                continue;
+            case LEX_ZERO:
+                if (is_digit(d)) { end_token(parser, TOKEN_ERROR, start, c, "Whole part of number can't have leading zeroes."); return NULL; }
+                // fall through
+            case LEX_INTEGER:
+                while (c < end && is_digit(*c)) { c++; }
+                if (c == end) { return c; }
+                if (*c == '.') { parser->lex = LEX_DOT; continue; }
+                if (*c == 'e' || *c == 'E') { parser->lex = LEX_EXPONENT_START; continue; }
+                break;
+            case LEX_DOT:
+                if (!is_digit(d)) { end_token(parser, TOKEN_ERROR, start, c, "need at least one digit for fraction."); return NULL; }
+                parser->lex = LEX_FRACTION;
+                continue;
+            case LEX_FRACTION:
+                while (c < end && is_digit(*c)) { c++; }
+                if (c == end) { return c; }
+                if (*c == 'e' || *c == 'E') { parser->lex = LEX_EXPONENT_START; continue; }
+                break;
+            case LEX_EXPONENT_START:
+                if (d == '+' || d == '-') { parser->lex = LEX_EXPONENT_SIGN; continue; }
+                // fall through
+            case LEX_EXPONENT_SIGN:
+                if (!is_digit(*c)) { end_token(parser, TOKEN_ERROR, start, c, "need at least one digit for exponent."); return NULL; }
+                parser->lex = LEX_EXPONENT;
+                continue;
+            default: // LEX_EXPONENT
+                while (c < end && is_digit(*c)) { c++; }
+                if (c == end) { return c; }
+                break;
+        }
+        return end_token(parser, TOKEN_NUMBER, start, c, "") ? c : NULL;
+    }
+    return c;
+}
+
+/*the keyword in word, or an error token if the letters don't spell one*/
+static bool end_keyword(StreamParser *parser, const char *start, const char *end)
+{
+    const unsigned int len = parser->word_len;
+    if (len == 4 && memcmp(parser->word, "true", 4) == 0) { return end_token(parser, TOKEN_TRUE, start, end, ""); }
+    if (len == 5 && memcmp(parser->word, "false", 5) == 0) { return end_token(parser, TOKEN_FALSE, start, end, ""); }
+    if (len == 4 && memcmp(parser->word, "null", 4) == 0) { return end_token(parser, TOKEN_NULL, start, end, ""); }
+    return end_token(parser, TOKEN_ERROR, start, end, "Invalid keyword.");
+}
+
+/*keywords = false, true, and null, the letters are collected in word until a non-letter*/
+static const char *keyword(StreamParser *parser, const char *start, const char *c, const char *end)
+{
+    for (; c < end && is_alpha(*c); c++)
+    {
+        if (parser->word_len < sizeof(parser->word)) { parser->word[parser->word_len] = *c; }
+        if (parser->word_len <= sizeof(parser->word)) { parser->word_len++; } // one more is enough to not be a keyword
+    }
+    if (c == end) { return c; }
+    return end_keyword(parser, start, c) ? c : NULL;
+}
+
+/*starts the token at c, the symbols are done at once*/
+static const char *start_token(StreamParser *parser, const char *c)
+{
+    switch (*c)
+    {
+        case '{': return end_token(parser, TOKEN_BEGIN_OBJECT, c, c + 1, "") ? c + 1 : NULL;
+        case '}': return end_token(parser, TOKEN_END_OBJECT, c, c + 1, "") ? c + 1 : NULL;
+        case '[': return end_token(parser, TOKEN_BEGIN_ARRAY, c, c + 1, "") ? c + 1 : NULL;
+        case ']': return end_token(parser, TOKEN_END_ARRAY, c, c + 1, "") ? c + 1 : NULL;
+        case ':': return end_token(parser, TOKEN_NAME_SEPARATOR, c, c + 1, "") ? c + 1 : NULL;
+        case ',': return end_token(parser, TOKEN_VALUE_SEPARATOR, c, c + 1, "") ? c + 1 : NULL;
+        case '"': parser->lex = LEX_STRING; return c + 1;
+        case '-': parser->lex = LEX_MINUS; return c + 1;
+        case '0': parser->lex = LEX_ZERO; return c + 1;
+    }
+    if (is_digit(*c))
+    {
+        parser->lex = LEX_INTEGER;
+        return c + 1;
+    }
+    if (is_alpha(*c))
+    {
+        parser->lex = LEX_KEYWORD;
+        parser->word_len = 0;
+        return c; // the keyword collects its first letter
+    }
+    end_token(parser, TOKEN_ERROR, c, c + 1, "Unrecognized character.");
+    return NULL;
+}
+
+/*goes on with the token that is not done yet*/
+static const char *continue_token(StreamParser *parser, const char *start, const char *c, const char *end)
+{
+    if (parser->lex <= LEX_UTF8_1) { return string(parser, start, c, end); }
+    if (parser->lex < LEX_KEYWORD) { return number(parser, start, c, end); }
+    return keyword(parser, start, c, end);
+}
+
+bool stream_feed(StreamParser *parser, const char *chunk, const size_t len)
+{
+    if (parser->error != NULL) { return false; }
+    const char *c = chunk;
+    const char *end = chunk + len;
+    const char *start = chunk; // a token split from the last chunk starts here
+    while (c < end)
+    {
+        if (parser->lex == LEX_NONE)
+        {
+            while (c < end && is_whitespace(*c))
+            {
+                if (*c == '\n') { parser->line++; }
+                c++;
+            }
+            if (c == end) { break; }
+            start = c;
+            c = start_token(parser, c);
+            if (c == NULL) { return false; }
+            if (parser->lex == LEX_NONE) { continue; }
+        }
+        c = continue_token(parser, start, c, end);
+        if (c == NULL) { return false; }
+    }
+    if (parser->lex != LEX_NONE)
+    {
+        parser->split = true;
+        if (parser->on_token != NULL && !keep(parser, start, end - start)) { return false; }
+    }
+    return true;
+}
+
+bool stream_finish(StreamParser *parser)
+{
+    if (parser->error != NULL) { return false; }
+    // the token the last chunk ended in is all in pending, what is left of it is an empty slice at its end
+    const char *rest = parser->pending != NULL ? parser->pending + parser->pending_len : "";
+    bool ended = true;
+    switch (parser->lex)
+    {
+        case LEX_NONE: break;
+        case LEX_ZERO:
+        case LEX_INTEGER:
+        case LEX_FRACTION:
+        case LEX_EXPONENT: ended = end_token(parser, TOKEN_NUMBER, rest, rest, ""); break;
+        case LEX_MINUS: ended = end_token(parser, TOKEN_ERROR, rest, rest, "Negative witout a number."); break;
+        case LEX_DOT: ended = end_token(parser, TOKEN_ERROR, rest, rest, "need at least one digit for fraction."); break;
+        case LEX_EXPONENT_START:
+        case LEX_EXPONENT_SIGN: ended = end_token(parser, TOKEN_ERROR, rest, rest, "need at least one digit for exponent."); break;
+        case LEX_KEYWORD: ended = end_keyword(parser, rest, rest); break;
+        default: ended = end_token(parser, TOKEN_ERROR, rest, rest, "Reached end of file without a string terminator."); break;
+    }
+    if (!ended) { return false; }
+    // the end of file is checked like any other token, so a cut off document fails with the error parse gives it
+    if (parser->expect != EXPECT_EOF) { return accept(parser, TOKEN_EOF); }
+
+    if (parser->on_token != NULL)
+    {
+        const Token eof = {.type = TOKEN_EOF, .start = NULL, .len = 0, .message = "", .msg_len = 0, .line = parser->line};
+        parser->on_token(parser->context, eof);
+    }
+    return true;
+}
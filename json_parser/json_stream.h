@@ -0,0 +1,62 @@
+#ifndef JSON_STREAM_H
+#define JSON_STREAM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "json_scanner.h"
+
+/*called for every token of the document in order, the lexeme is only valid during the call*/
+typedef void (*TokenHandler)(void *context, const Token token);
+
+/********************************************************************************
+ * A push parser for documents that don't fit in memory. The document is fed to
+ * it in chunks of any size as they are read, the parser never looks back at an
+ * earlier chunk, so a chunk can be reused as soon as stream_feed returns.
+ * A token split across chunks (a string, a number, an escape, a keyword) is
+ * picked up where it stopped: lex is the state of the token the last chunk
+ * ended in, and nesting the objects and arrays that are still open, one byte
+ * each, with expect the grammar state.
+ * Without a token handler nothing of the document is kept, the memory is the
+ * nesting depth, which is at most max_depth bytes: PARSER_MAX_DEPTH (from
+ * json_parser.h) after init_stream_parser, it can be set to anything before
+ * the first chunk, a document nested deeper is an error. With one, the part of a split token that came in the earlier
+ * chunks is copied to pending so the handler gets the whole lexeme, which is
+ * as long as the longest token that crosses a chunk boundary.
+ * The first error stops the parse, error and line tell what and where.
+ ********************************************************************************/
+typedef struct
+{
+    TokenHandler on_token;
+    void *context;
+    unsigned int lex;
+    unsigned int expect;
+    char *nesting;
+    size_t depth;
+    size_t nesting_capacity;
+    size_t max_depth;
+    char *pending;
+    size_t pending_len;
+    size_t pending_capacity;
+    bool split;
+    char word[5];
+    unsigned int word_len;
+    unsigned char utf8_low;
+    unsigned char utf8_high;
+    unsigned int line;
+    const char *error;
+} StreamParser;
+
+/*initializes the parser to the start of a document, on_token can be NULL to only validate*/
+void init_stream_parser(StreamParser *parser, TokenHandler on_token, void *context);
+
+/*frees the memory the parser holds, the parser can be initialized again for another document*/
+void free_stream_parser(StreamParser *parser);
+
+/*parses the next len bytes of the document, returns false once the document is not valid*/
+bool stream_feed(StreamParser *parser, const char *chunk, const size_t len);
+
+/*ends the document after the last chunk, returns true if it was a whole valid document*/
+bool stream_finish(StreamParser *parser);
+
+#endif
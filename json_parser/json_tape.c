@@ -0,0 +1,183 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "json_tape.h"
+
+void init_tape(TokenTape *tape)
+{
+    tape->source = NULL;
+    tape->len = 0;
+    tape->entries = NULL;
+    tape->count = 0;
+    tape->capacity = 0;
+    tape->error = NULL;
+    tape->error_entry = 0;
+    tape->open = NULL;
+    tape->open_capacity = 0;
+}
+
+void free_tape(TokenTape *tape)
+{
+    free(tape->entries);
+    free(tape->open);
+    init_tape(tape);
+}
+
+/*doubles the entries when they are full, a document has at most one token per byte*/
+static bool grow_entries(TokenTape *tape)
+{
+    size_t capacity = tape->capacity == 0 ? 4096 : tape->capacity * 2;
+    uint64_t *entries = (uint64_t *)realloc(tape->entries, capacity * sizeof(uint64_t));
+    if (entries == NULL) { return false; }
+    tape->entries = entries;
+    tape->capacity = capacity;
+    return true;
+}
+
+static bool grow_open(TokenTape *tape)
+{
+    size_t capacity = tape->open_capacity == 0 ? 64 : tape->open_capacity * 2;
+    size_t *open = (size_t *)realloc(tape->open, capacity * sizeof(size_t));
+    if (open == NULL) { return false; }
+    tape->open = open;
+    tape->open_capacity = capacity;
+    return true;
+}
+
+/********************************************************************************
+ * scans the tokens one after the other and writes an entry for each. A '{' or
+ * '[' waits on open until its match comes, then its entry is set to the index
+ * of the match. A '}' or ']' that doesn't match the last one open (an invalid
+ * document) is left as it is, and whatever is still open at the end matches
+ * the EOF entry. The tape ends right after the first error.
+ ********************************************************************************/
+bool tokenize(TokenTape *tape, const char *source, const size_t len)
+{
+    tape->source = source;
+    tape->len = len;
+    tape->count = 0;
+    tape->error = NULL;
+    tape->error_entry = 0;
+
+    Scanner scanner;
+    init_scanner(&scanner, source, len);
+    size_t depth = 0;
+    for (;;)
+    {
+        const Token token = scan_token(&scanner);
+        if (tape->count == tape->capacity && !grow_entries(tape)) { return false; }
+        const size_t entry = tape->count++;
+        // EOF keeps the start of the last token, it is at the end of the document
+        const size_t offset = (token.type == TOKEN_EOF ? scanner.current : token.start) - source;
+        uint64_t flags = token.type;
+        switch (token.type)
+        {
+            case TOKEN_BEGIN_OBJECT:
+            case TOKEN_BEGIN_ARRAY:
+                if (depth == tape->open_capacity && !grow_open(tape)) { return false; }
+                tape->open[depth++] = entry;
+                break;
+            case TOKEN_END_OBJECT:
+            case TOKEN_END_ARRAY:
+            {
+                const TokenType begin = token.type == TOKEN_END_OBJECT ? TOKEN_BEGIN_OBJECT : TOKEN_BEGIN_ARRAY;
+                if (depth > 0 && tape_type(tape, tape->open[depth - 1]) == begin)
+                {
+                    depth--;
+                    tape->entries[tape->open[depth]] |= (uint64_t)entry << TAPE_PAYLOAD_SHIFT;
+                }
+                break;
+            }
+            case TOKEN_STRING:
+                if (scanner.escaped) { flags |= TAPE_ESCAPED; }
+                break;
+            case TOKEN_ERROR:
+                tape->error = token.message;
+                tape->error_entry = entry;
+                break;
+            default:
+                break;
+        }
+        if (token.type == TOKEN_BEGIN_OBJECT || token.type == TOKEN_BEGIN_ARRAY) { tape->entries[entry] = flags; }
+        else { tape->entries[entry] = flags | (uint64_t)offset << TAPE_PAYLOAD_SHIFT; }
+        if (token.type == TOKEN_EOF) { break; }
+        if (token.type == TOKEN_ERROR)
+        {
+            // the EOF is where the scanner stopped, so the error token is its lexeme
+            if (tape->count == tape->capacity && !grow_entries(tape)) { return false; }
+            tape->entries[tape->count++] = TOKEN_EOF | (uint64_t)(scanner.current - source) << TAPE_PAYLOAD_SHIFT;
+            break;
+        }
+    }
+    while (depth > 0)
+    {
+        depth--;
+        tape->entries[tape->open[depth]] |= (uint64_t)(tape->count - 1) << TAPE_PAYLOAD_SHIFT;
+    }
+    return true;
+}
+
+static bool is_whitespace(const char c)
+{
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r';
+}
+
+/********************************************************************************
+ * the entries of a '{' or '[' have no offset, but only whitespace is between
+ * one and the next token. The next entry that has an offset is found, and each
+ * '{' or '[' before it is the last char that is not whitespace before the one
+ * after it.
+ ********************************************************************************/
+size_t tape_offset(const TokenTape *tape, const size_t entry)
+{
+    size_t next = entry;
+    while (tape_type(tape, next) == TOKEN_BEGIN_OBJECT || tape_type(tape, next) == TOKEN_BEGIN_ARRAY) { next++; }
+    size_t offset = tape->entries[next] >> TAPE_PAYLOAD_SHIFT;
+    for (size_t brackets = next - entry; brackets > 0; brackets--)
+    {
+        offset--;
+        while (is_whitespace(tape->source[offset])) { offset--; }
+    }
+    return offset;
+}
+
+Token tape_token(const TokenTape *tape, const size_t entry)
+{
+    const TokenType type = tape_type(tape, entry);
+    const size_t offset = tape_offset(tape, entry);
+    size_t end = offset;
+    if (type != TOKEN_EOF)
+    {
+        end = tape_offset(tape, entry + 1);
+        while (type != TOKEN_ERROR && end > offset + 1 && is_whitespace(tape->source[end - 1])) { end--; }
+    }
+    Token token = {
+        .type = type,
+        .start = tape->source + offset,
+        .len = end - offset,
+        .message = "",
+        .msg_len = 0,
+        .line = 0
+    };
+    if (type == TOKEN_ERROR)
+    {
+        token.message = tape->error;
+        token.msg_len = strlen(token.message);
+        token.line = tape_line(tape, entry);
+    }
+    return token;
+}
+
+unsigned int tape_line(const TokenTape *tape, const size_t entry)
+{
+    const char *c = tape->source;
+    const char *end = tape->source + tape_offset(tape, entry);
+    unsigned int line = 1;
+    while ((c = memchr(c, '\n', end - c)) != NULL)
+    {
+        line++;
+        c++;
+    }
+    return line;
+}
@@ -0,0 +1,82 @@
+#ifndef JSON_TAPE_H
+#define JSON_TAPE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "json_scanner.h"
+
+/*the token type is in the low 4 bits of an entry, the flags above it, and the offset or match in the top 56 bits*/
+#define TAPE_TYPE_MASK 0x0f
+#define TAPE_ESCAPED 0x10 // a string with an escape in it
+#define TAPE_PAYLOAD_SHIFT 8
+
+/********************************************************************************
+ * Every token of a document in order, 8 bytes each: its type and where it is.
+ * An entry is the offset of its token in the source, except the entry of a '{'
+ * or '[' which is the index of the entry of its matching '}' or ']', so a
+ * whole object or array is skipped in one step. An object or array that is
+ * never closed matches the last entry. Nothing but whitespace is between two
+ * tokens, so the end of a token is the start of the next one without the
+ * whitespace before it, and a '{' or '[' is the last char before the next
+ * token. The tape always ends with an EOF entry.
+ * The tape stops at the first error token, it is followed by the EOF entry
+ * (where the scanner stopped). error is its message, NULL if there is none,
+ * and error_entry its index.
+ * The tape is owned by the caller and kept between documents like the scratch
+ * stack of a parser, open is the objects and arrays waiting for their match.
+ ********************************************************************************/
+typedef struct
+{
+    const char *source;
+    size_t len;
+    uint64_t *entries;
+    size_t count;
+    size_t capacity;
+    const char *error;
+    size_t error_entry;
+    size_t *open;
+    size_t open_capacity;
+} TokenTape;
+
+/*initializes an empty tape, must be called before it is first filled*/
+void init_tape(TokenTape *tape);
+
+/*frees the entries of the tape*/
+void free_tape(TokenTape *tape);
+
+/********************************************************************************
+ * scans every token of the document of len bytes onto the tape, replacing what
+ * was on it. The document has to be kept as long as the tape is read. Returns
+ * false only when out of memory, an invalid document is a tape with an error.
+ ********************************************************************************/
+bool tokenize(TokenTape *tape, const char *source, const size_t len);
+
+static inline TokenType tape_type(const TokenTape *tape, const size_t entry)
+{
+    return (TokenType)(tape->entries[entry] & TAPE_TYPE_MASK);
+}
+
+/*the entry after the value at entry, the whole object or array when it starts one*/
+static inline size_t tape_skip(const TokenTape *tape, const size_t entry)
+{
+    const TokenType type = tape_type(tape, entry);
+    if (type == TOKEN_BEGIN_OBJECT || type == TOKEN_BEGIN_ARRAY) { return (tape->entries[entry] >> TAPE_PAYLOAD_SHIFT) + 1; }
+    return entry + 1;
+}
+
+/*the offset of the token in the source*/
+size_t tape_offset(const TokenTape *tape, const size_t entry);
+
+/********************************************************************************
+ * the token of the entry, its lexeme ends where the next token starts (without
+ * the whitespace before it). Finding where a '{' or '[' is takes a step for
+ * every '{' or '[' right after it. The line is only counted for an error.
+ ********************************************************************************/
+Token tape_token(const TokenTape *tape, const size_t entry);
+
+/*the line of the token, counted from the start of the document*/
+unsigned int tape_line(const TokenTape *tape, const size_t entry);
+
+#endif
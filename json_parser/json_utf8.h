@@ -0,0 +1,123 @@
+#ifndef JSON_UTF8_H
+#define JSON_UTF8_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/********************************************************************************
+ * the utf-8 character (RFC 3629) a lead byte starts: returns its length, 1 for
+ * ascii and 0 for a byte that can't start a character, and sets the range of
+ * the byte after it. Only the second byte has a range of its own, it rules out
+ * the overlong forms, the surrogates, and the code points past U+10FFFF, every
+ * other continuation byte is 0x80 to 0xbf.
+ ********************************************************************************/
+static inline unsigned int utf8_lead(const unsigned char c, unsigned char *low, unsigned char *high)
+{
+    *low = 0x80;
+    *high = 0xbf;
+    if (c < 0x80) { return 1; }
+    if (c < 0xc2) { return 0; } // a continuation byte or an overlong 2 byte lead
+    if (c < 0xe0) { return 2; }
+    if (c < 0xf0)
+    {
+        if (c == 0xe0) { *low = 0xa0; }
+        if (c == 0xed) { *high = 0x9f; }
+        return 3;
+    }
+    if (c < 0xf5)
+    {
+        if (c == 0xf0) { *low = 0x90; }
+        if (c == 0xf4) { *high = 0x8f; }
+        return 4;
+    }
+    return 0;
+}
+
+/*true if the bytes of the character at c that are before end are valid, a character cut off by end is valid as far as it goes*/
+static inline bool utf8_valid_prefix(const unsigned char *c, const unsigned char *end, const unsigned int len,
+                                     const unsigned char low, const unsigned char high)
+{
+    if (len == 0) { return false; }
+    if (len == 1 || c + 1 == end) { return true; }
+    if (c[1] < low || c[1] > high) { return false; }
+    for (unsigned int i = 2; i < len && c + i < end; i++)
+    {
+        if ((c[i] & 0xc0) != 0x80) { return false; }
+    }
+    return true;
+}
+
+/*the length of the utf-8 character at c, 0 if it is not valid or end cuts it off*/
+static inline unsigned int utf8_length(const unsigned char *c, const unsigned char *end)
+{
+    unsigned char low, high;
+    const unsigned int len = utf8_lead(*c, &low, &high);
+    if ((size_t)(end - c) < len || !utf8_valid_prefix(c, end, len, low, high)) { return 0; }
+    return len;
+}
+
+/*writes the code point as utf-8 and returns the number of bytes*/
+static inline unsigned int utf8_encode(char *out, const unsigned int code_point)
+{
+    if (code_point < 0x80)
+    {
+        out[0] = code_point;
+        return 1;
+    }
+    if (code_point < 0x800)
+    {
+        out[0] = 0xc0 | code_point >> 6;
+        out[1] = 0x80 | (code_point & 0x3f);
+        return 2;
+    }
+    if (code_point < 0x10000)
+    {
+        out[0] = 0xe0 | code_point >> 12;
+        out[1] = 0x80 | (code_point >> 6 & 0x3f);
+        out[2] = 0x80 | (code_point & 0x3f);
+        return 3;
+    }
+    out[0] = 0xf0 | code_point >> 18;
+    out[1] = 0x80 | (code_point >> 12 & 0x3f);
+    out[2] = 0x80 | (code_point >> 6 & 0x3f);
+    out[3] = 0x80 | (code_point & 0x3f);
+    return 4;
+}
+
+/*hex digit to its value, the scanner already checked it is a hex digit*/
+static inline unsigned int hex_value(const char c)
+{
+    if (c <= '9') { return c - '0'; }
+    return (c | 0x20) - 'a' + 10;
+}
+
+static inline unsigned int read_hex4(const char *hex)
+{
+    return hex_value(hex[0]) << 12 | hex_value(hex[1]) << 8 | hex_value(hex[2]) << 4 | hex_value(hex[3]);
+}
+
+/********************************************************************************
+ * writes the character of the \uXXXX escape at in (its backslash) to out as
+ * utf-8 and returns the number of bytes, at most 4. A high surrogate with a low
+ * one in the escape right after it (before end) is one character, a lone
+ * surrogate is U+FFFD. escape_len is set to the length of the escapes read,
+ * 6 or 12. The parser and the lazy key compare both decode \u with it.
+ ********************************************************************************/
+static inline unsigned int utf8_unescape(const char *in, const char *end, char *out, unsigned int *escape_len)
+{
+    unsigned int code_point = read_hex4(in + 2);
+    *escape_len = 6;
+    if (code_point >= 0xd800 && code_point < 0xdc00 && end - in >= 12 && in[6] == '\\' && in[7] == 'u')
+    {
+        const unsigned int low = read_hex4(in + 8);
+        if (low >= 0xdc00 && low < 0xe000)
+        {
+            code_point = 0x10000 + ((code_point - 0xd800) << 10) + (low - 0xdc00);
+            *escape_len = 12;
+        }
+    }
+    if (code_point >= 0xd800 && code_point < 0xe000) { code_point = 0xfffd; }
+    return utf8_encode(out, code_point);
+}
+
+#endif
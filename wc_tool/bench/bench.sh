@@ -0,0 +1,117 @@
+#!/bin/sh
+# times each given wc binary over reproducible generated corpora and prints the
+# throughput and cycles per byte for every corpus, size, and flag set.
+# usage: bench/bench.sh [binary]...    (defaults to ./ccwc and the system wc)
+#
+# KINDS      corpora to generate (ascii-log utf8 long-lines whitespace binary)
+# SIZES      corpus sizes in MB
+# FLAG_SETS  flag sets to run, '-' runs without flags
+# INPUTS     file, pipe (cat corpus | binary), or both
+# RUNS       runs per measurement, the fastest is reported
+# CPU_GHZ    clock used for cycles/byte, read from /proc/cpuinfo when not set
+# CORPUS_DIR where the corpora are kept between runs
+# SMALL_FILES number of small files counted through --files0-from, 0 skips them
+# SMALL_SIZE  size of each small file, as accepted by split -b
+
+KINDS=${KINDS:-ascii-log utf8 long-lines whitespace binary}
+SIZES=${SIZES:-16 256}
+FLAG_SETS=${FLAG_SETS:-- -l -w -m -c -lwmc}
+INPUTS=${INPUTS:-file pipe}
+RUNS=${RUNS:-3}
+CORPUS_DIR=${CORPUS_DIR:-/tmp/ccwc_bench}
+SMALL_FILES=${SMALL_FILES:-20000}
+SMALL_SIZE=${SMALL_SIZE:-2K}
+
+# the system wc only counts utf-8 characters for -m in a utf-8 locale
+LC_ALL=${LC_ALL:-C.UTF-8}
+export LC_ALL
+
+dir=$(dirname "$0")
+if [ $# -eq 0 ]; then set -- ./ccwc wc; fi
+
+if [ -z "$CPU_GHZ" ]; then
+    CPU_GHZ=$(awk -F: '/cpu MHz/ { printf "%.2f", $2 / 1000; exit }' /proc/cpuinfo 2>/dev/null)
+fi
+CPU_GHZ=${CPU_GHZ:-0}
+
+mkdir -p "$CORPUS_DIR" || exit 1
+gen=$CORPUS_DIR/gen_corpus
+if [ ! -x "$gen" ] || [ "$dir/gen_corpus.c" -nt "$gen" ]; then
+    ${CC:-gcc} -O2 -Wall -o "$gen" "$dir/gen_corpus.c" || exit 1
+fi
+
+# prints the best of RUNS for a binary, reading the corpus as a file or through a pipe
+run() {
+    bin=$1
+    flags=$2
+    input=$3
+    best=0
+    i=0
+    [ "$flags" = - ] && flags=
+    while [ $i -lt "$RUNS" ]; do
+        start=$(date +%s%N)
+        if [ "$input" = pipe ]; then
+            cat "$corpus" | $bin $flags > /dev/null
+        else
+            $bin $flags "$corpus" > /dev/null
+        fi
+        end=$(date +%s%N)
+        ns=$((end - start))
+        if [ $best -eq 0 ] || [ $ns -lt $best ]; then best=$ns; fi
+        i=$((i + 1))
+    done
+    awk -v k="$kind" -v s="$size" -v b="$bin" -v f="${flags:--}" -v mode="$input" -v ns="$best" -v bytes="$bytes" -v ghz="$CPU_GHZ" \
+        'BEGIN { cpb = ghz > 0 ? sprintf("%.3f", ns * ghz / bytes) : "n/a";
+                 printf "%-11s %6s %-16s %-6s %-5s %9.3f %8.2f %9s\n", k, s, b, f, mode, ns / 1e9, bytes / ns, cpb }'
+}
+
+echo "cpu clock: $CPU_GHZ GHz"
+printf '%-11s %6s %-16s %-6s %-5s %9s %8s %9s\n' corpus MB binary flags input seconds GB/s cycles/B
+for kind in $KINDS; do
+    for size in $SIZES; do
+        corpus=$CORPUS_DIR/$kind-$size
+        # a corpus made by an older generator is made again
+        if [ ! -f "$corpus" ] || [ "$gen" -nt "$corpus" ]; then "$gen" "$kind" "$size" "$corpus" || exit 1; fi
+        bytes=$(wc -c < "$corpus")
+        cat "$corpus" > /dev/null # warm the page cache
+        for flags in $FLAG_SETS; do
+            for input in $INPUTS; do
+                for bin in "$@"; do
+                    run "$bin" "$flags" "$input"
+                done
+            done
+        done
+    done
+done
+
+# many small files, the names are passed with --files0-from so the argument list doesn't limit them
+[ "$SMALL_FILES" -gt 0 ] || exit 0
+small=$CORPUS_DIR/small-$SMALL_FILES-$SMALL_SIZE
+if [ ! -d "$small" ] || [ "$gen" -nt "$small" ]; then
+    rm -rf "$small"
+    mkdir -p "$small" || exit 1
+    bytes_each=$(echo "$SMALL_SIZE" | awk '{ n = $1 + 0; u = substr($1, length($1)); if (u == "K") n *= 1024; if (u == "M") n *= 1048576; print n }')
+    mb=$(( (SMALL_FILES * bytes_each + 1048575) / 1048576 ))
+    "$gen" ascii-log "$mb" "$small.corpus" || exit 1
+    (cd "$small" && split -a 6 -b "$SMALL_SIZE" "$small.corpus" f && ls | tail -n +$((SMALL_FILES + 1)) | xargs -r rm)
+    rm -f "$small.corpus"
+fi
+bytes=$(cat "$small"/* | wc -c)
+find "$small" -type f -print0 > "$small.list"
+echo
+echo "$SMALL_FILES files of $SMALL_SIZE"
+printf '%-16s %9s %10s %8s\n' binary seconds files/s GB/s
+for bin in "$@"; do
+    best=0
+    i=0
+    while [ $i -lt "$RUNS" ]; do
+        start=$(date +%s%N)
+        $bin --files0-from="$small.list" > /dev/null
+        end=$(date +%s%N)
+        ns=$((end - start))
+        if [ $best -eq 0 ] || [ $ns -lt $best ]; then best=$ns; fi
+        i=$((i + 1))
+    done
+    awk -v b="$bin" -v ns="$best" -v n="$SMALL_FILES" -v bytes="$bytes" \
+        'BEGIN { printf "%-16s %9.3f %10.0f %8.2f\n", b, ns / 1e9, n * 1e9 / ns, bytes / ns }'
+done
@@ -0,0 +1,161 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/********************************************************************************
+ * generates a reproducible benchmark corpus, the same kind, size, and seed
+ * always produce the same bytes.
+ * usage: gen_corpus kind size_mb output [seed]
+ * kinds: ascii-log, utf8, long-lines, whitespace, binary
+ ********************************************************************************/
+
+#define CHUNK (1u << 16)
+
+/*xorshift64*, small and the same everywhere*/
+static uint64_t state;
+
+static uint64_t next_random()
+{
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 0x2545F4914F6CDD1DULL;
+}
+
+static uint32_t below(const uint32_t n)
+{
+    return next_random() % n;
+}
+
+static const char* words[] = {
+    "GET", "POST", "/api/v1/users", "/index.html", "200", "404", "500", "ms", "user", "session",
+    "connection", "timeout", "retry", "cache", "miss", "hit", "worker", "request", "response", "ok"
+};
+static const char* levels[] = {"INFO", "WARN", "ERROR", "DEBUG"};
+
+/*multi-byte words: latin accents, greek, cjk, and emoji*/
+static const char* utf8_words[] = {
+    "caf\xc3\xa9", "na\xc3\xafve", "\xce\xb1\xce\xbb\xcf\x86\xce\xb1", "\xe6\x97\xa5\xe6\x9c\xac\xe8\xaa\x9e",
+    "\xe4\xb8\xad\xe6\x96\x87", "\xf0\x9f\x98\x80", "\xd0\xbf\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82", "word"
+};
+
+/*fills the max bytes left in the chunk with spaces and a newline when the next piece doesn't fit, so no line or character is cut*/
+static size_t pad(char* out, const size_t max)
+{
+    memset(out, ' ', max);
+    out[max - 1] = '\n';
+    return max;
+}
+
+/*appends at most max bytes of the next piece of the corpus to out and returns the length*/
+static size_t ascii_log(char* out, const size_t max)
+{
+    char line[256];
+    int len = snprintf(line, sizeof(line), "2024-01-%02u %02u:%02u:%02u.%03u [%s] ", 1 + below(28), below(24), below(60),
+                       below(60), below(1000), levels[below(4)]);
+    const uint32_t count = 4 + below(12);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        len += snprintf(line + len, sizeof(line) - len, "%s ", words[below(20)]);
+    }
+    line[len - 1] = '\n';
+    if ((size_t)len > max) { return pad(out, max); }
+    memcpy(out, line, len);
+    return len;
+}
+
+static size_t utf8(char* out, const size_t max)
+{
+    const char* word = utf8_words[below(8)];
+    size_t len = strlen(word);
+    char piece[32];
+    memcpy(piece, word, len);
+    piece[len++] = below(10) == 0 ? '\n' : ' ';
+    if (len > max) { return pad(out, max); }
+    memcpy(out, piece, len);
+    return len;
+}
+
+/*lines of 64 KiB to 1 MiB with words of 1 to 16 letters*/
+static size_t long_lines(char* out, const size_t max)
+{
+    static size_t line_left = 0;
+    if (line_left == 0)
+    {
+        line_left = (64u << 10) + below(960u << 10);
+        out[0] = '\n';
+        return 1;
+    }
+    size_t len = 1 + below(16);
+    if (len + 1 > max) { len = max - 1; }
+    for (size_t i = 0; i < len; i++) { out[i] = 'a' + below(26); }
+    out[len++] = ' ';
+    line_left = line_left > len ? line_left - len : 0;
+    return len;
+}
+
+static size_t whitespace(char* out, const size_t max)
+{
+    static const char spaces[] = {' ', ' ', ' ', '\t', '\n', '\r'};
+    out[0] = spaces[below(6)];
+    return 1;
+}
+
+static size_t binary(char* out, const size_t max)
+{
+    const uint64_t r = next_random();
+    const size_t len = max < 8 ? max : 8;
+    memcpy(out, &r, len);
+    return len;
+}
+
+typedef size_t (*Generator)(char* out, size_t max);
+
+static Generator find_generator(const char* kind)
+{
+    if (strcmp(kind, "ascii-log") == 0) { return ascii_log; }
+    if (strcmp(kind, "utf8") == 0) { return utf8; }
+    if (strcmp(kind, "long-lines") == 0) { return long_lines; }
+    if (strcmp(kind, "whitespace") == 0) { return whitespace; }
+    if (strcmp(kind, "binary") == 0) { return binary; }
+    return NULL;
+}
+
+int main(const int argc, const char* argv[])
+{
+    if (argc < 4 || argc > 5)
+    {
+        fprintf(stderr, "usage: gen_corpus kind size_mb output [seed]\n");
+        return 1;
+    }
+    const Generator generate = find_generator(argv[1]);
+    if (generate == NULL)
+    {
+        fprintf(stderr, "unknown kind [%s]\n", argv[1]);
+        return 1;
+    }
+    const uint64_t size = strtoull(argv[2], NULL, 10) << 20;
+    state = argc == 5 ? strtoull(argv[4], NULL, 10) : 0x9E3779B97F4A7C15ULL;
+    if (state == 0) { state = 1; }
+
+    FILE* out = fopen(argv[3], "wb");
+    char* buffer = malloc(CHUNK);
+    if (out == NULL || buffer == NULL)
+    {
+        fprintf(stderr, "[%s] Could not open file.\n", argv[3]);
+        return 1;
+    }
+    uint64_t written = 0;
+    while (written < size)
+    {
+        size_t fill = 0;
+        const size_t limit = size - written < CHUNK ? size - written : CHUNK;
+        while (fill < limit) { fill += generate(buffer + fill, limit - fill); }
+        fwrite(buffer, 1, fill, out);
+        written += fill;
+    }
+    free(buffer);
+    fclose(out);
+    return 0;
+}
@@ -1,7 +1,22 @@
+#define _GNU_SOURCE // F_SETPIPE_SZ and splice
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "wc_kernel.h"
+#include "wc_pool.h"
+#include "wc_state.h"
+#include "wc_uring.h"
 
 /*the flags to determine what should get printed*/
 #define WC_INVALID_FLAG 0u
@@ -16,50 +31,262 @@
 typedef struct
 {
     bool error;
-    unsigned int line_count;
-    unsigned int word_count;
-    unsigned int char_count;
-    unsigned int byte_count;
+    uint64_t line_count;
+    uint64_t word_count;
+    uint64_t char_count;
+    uint64_t byte_count;
 } WCFile;
 
 /*the struct for the totals*/
 typedef struct
 {
-    unsigned long line_count;
-    unsigned long word_count;
-    unsigned long char_count;
-    unsigned long byte_count;
+    uint64_t line_count;
+    uint64_t word_count;
+    uint64_t char_count;
+    uint64_t byte_count;
 } WCTotal;
 
-static bool is_whitespace(const char c)
+/*what the kernel has to count (WC_COUNT_*), set once the flags are parsed*/
+static unsigned int wc_counting = WC_COUNT_ALL;
+
+/*the checkpoints of --incremental, NULL when every file is counted in full*/
+static WCState* wc_state = NULL;
+
+/*size and alignment of the read buffer used for streams that can't be mapped*/
+#define WC_BUFFER_SIZE  (1u << 20)
+#define WC_BUFFER_ALIGN 4096
+/*the size pipes are grown to, the default 64 KiB pipe makes the writer and ccwc take turns*/
+#define WC_PIPE_SIZE    (1 << 20)
+
+static pthread_key_t buffer_key;
+static pthread_once_t buffer_once = PTHREAD_ONCE_INIT;
+
+static void create_buffer_key()
+{
+    pthread_key_create(&buffer_key, free);
+}
+
+/*returns the read buffer of the calling thread, allocated on first use and reused for every stream after*/
+static unsigned char* stream_buffer()
+{
+    pthread_once(&buffer_once, create_buffer_key);
+    unsigned char* buffer = pthread_getspecific(buffer_key);
+    if (buffer == NULL)
+    {
+        buffer = aligned_alloc(WC_BUFFER_ALIGN, WC_BUFFER_SIZE);
+        if (buffer != NULL && pthread_setspecific(buffer_key, buffer) != 0)
+        {
+            free(buffer);
+            return NULL;
+        }
+    }
+    return buffer;
+}
+
+/*maps the bytes of a regular file from start to end into memory and counts them in one block*/
+static bool wc_mapped(WCCounts* counts, const int fd, const uint64_t start, const uint64_t end)
+{
+    const uint64_t base = start - start % sysconf(_SC_PAGESIZE); // the offset of a mapping must be page aligned
+    void* data = mmap(NULL, end - base, PROT_READ, MAP_PRIVATE, fd, base);
+    if (data == MAP_FAILED) { return false; }
+    madvise(data, end - base, MADV_SEQUENTIAL);
+    wc_count(counts, (const unsigned char*)data + (start - base), end - start);
+    munmap(data, end - base);
+    return true;
+}
+
+/********************************************************************************
+ * reads the stream in large aligned blocks, a read error ends the stream like
+ * EOF did with fgetc. A pipe is grown first so the writer can get far ahead and
+ * every read returns up to a full buffer instead of a 64 KiB pipe's worth.
+ ********************************************************************************/
+static bool wc_stream(WCCounts* counts, const int fd, const bool is_pipe)
+{
+    unsigned char* buffer = stream_buffer();
+    if (buffer == NULL) { return false; }
+    if (is_pipe) { fcntl(fd, F_SETPIPE_SZ, WC_PIPE_SIZE); } // best effort, the limit may be lower
+    for (;;)
+    {
+        const ssize_t len = read(fd, buffer, WC_BUFFER_SIZE);
+        if (len < 0 && errno == EINTR) { continue; }
+        if (len <= 0) { break; }
+        wc_count(counts, buffer, len);
+    }
+    return true;
+}
+
+/********************************************************************************
+ * counts the bytes of a pipe without copying them, splice moves the pages of
+ * the pipe straight to /dev/null. Returns false if nothing could be spliced so
+ * the caller can read the pipe instead.
+ ********************************************************************************/
+static bool wc_spliced(WCCounts* counts, const int fd)
+{
+    const int null_fd = open("/dev/null", O_WRONLY);
+    if (null_fd < 0) { return false; }
+    fcntl(fd, F_SETPIPE_SZ, WC_PIPE_SIZE);
+    bool spliced = false;
+    for (;;)
+    {
+        const ssize_t len = splice(fd, NULL, null_fd, NULL, WC_PIPE_SIZE, SPLICE_F_MOVE);
+        if (len < 0 && errno == EINTR) { continue; }
+        if (len < 0 && !spliced) { break; } // not supported, nothing was lost
+        if (len <= 0)
+        {
+            spliced = true; // a later error ends the stream like a read error does
+            break;
+        }
+        counts->byte_count += len;
+        spliced = true;
+    }
+    close(null_fd);
+    return spliced;
+}
+
+static WCFile to_wc_file(const WCCounts* counts, const bool counted)
 {
-    return c == ' ' || c == '\n'  || c == '\t' || c == '\r';
+    return (WCFile){!counted, counts->line_count, counts->word_count, counts->char_count, counts->byte_count};
 }
 
 /*scans a file in a single pass and records the counts then returns the WCFile with the scan info*/
-static WCFile wc_file(FILE* input_stream)
+static WCFile wc_file(const int fd)
 {
-    WCFile file = {false, 0, 0, 0, 0};
-    bool in_word = false;
-    char c = fgetc(input_stream);
-    while (c != EOF)
+    WCCounts counts = {0, 0, 0, 0, false};
+    bool counted = false;
+    struct stat st;
+    const bool has_stat = fstat(fd, &st) == 0;
+    if (has_stat && S_ISREG(st.st_mode) && st.st_size > 0)
     {
-        file.byte_count++;
-        file.char_count++;
-        if (c == '\n') { file.line_count++; }
-        if (is_whitespace(c))
+        if (wc_counting == WC_COUNT_BYTES)
         {
-            if (in_word)
-            {
-                file.word_count++;
-                in_word = false;
-            }
+            counts.byte_count = st.st_size;
+            counted = true;
         }
-        else { in_word = true; }
+        else { counted = wc_mapped(&counts, fd, 0, st.st_size); }
+    }
+    if (!counted && has_stat && S_ISFIFO(st.st_mode) && wc_counting == WC_COUNT_BYTES) { counted = wc_spliced(&counts, fd); }
+    if (!counted) { counted = wc_stream(&counts, fd, has_stat && S_ISFIFO(st.st_mode)); }
+    return to_wc_file(&counts, counted);
+}
+
+/********************************************************************************
+ * counts a regular file from its checkpoint, so only the bytes appended since
+ * the last run are read, and records the new checkpoint. The file is counted in
+ * full when it has no checkpoint or it was truncated or replaced (rotated).
+ * Anything that isn't a regular file is counted by wc_file.
+ ********************************************************************************/
+static WCFile wc_file_incremental(const char* name, const int fd)
+{
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) { return wc_file(fd); }
+    const uint64_t size = st.st_size;
+    WCCheckpoint checkpoint = {st.st_dev, st.st_ino, 0, size < WC_HEAD_LEN ? size : WC_HEAD_LEN, 0, {0, 0, 0, 0, false}, (char*)name};
+    if (!wc_head_hash(fd, checkpoint.head_len, &checkpoint.head_hash)) { return wc_file(fd); }
+
+    const WCCheckpoint* last = wc_state_find(wc_state, name);
+    uint64_t head_hash;
+    if (last != NULL && last->dev == (uint64_t)st.st_dev && last->ino == (uint64_t)st.st_ino && last->offset <= size
+        && wc_head_hash(fd, last->head_len, &head_hash) && head_hash == last->head_hash)
+    {
+        checkpoint.offset = last->offset;
+        checkpoint.counts = last->counts;
+    }
+    if (size > checkpoint.offset && !wc_mapped(&checkpoint.counts, fd, checkpoint.offset, size)) { return wc_file(fd); }
+    checkpoint.offset = size;
+    wc_state_update(wc_state, &checkpoint); // if it fails the file is counted in full next time
+    return to_wc_file(&checkpoint.counts, true);
+}
+
+/*counts a file that was opened by name, from its checkpoint with --incremental*/
+static WCFile wc_named_file(const char* name, const int fd)
+{
+    if (wc_state != NULL) { return wc_file_incremental(name, fd); }
+    return wc_file(fd);
+}
+
+/*regular files at least this large are split across the workers when -j is given*/
+#define WC_SPLIT_MIN (64u << 20)
+/*the smallest chunk a file is split into, and the number of chunks per worker*/
+#define WC_CHUNK_MIN        (8u << 20)
+#define WC_CHUNKS_PER_JOB   4
 
-        c = fgetc(input_stream);
+/*a mapped file split into chunks, each chunk is counted on its own*/
+typedef struct
+{
+    const unsigned char* data;
+    size_t size;
+    size_t num_chunks;
+    WCCounts* chunks;
+} WCSplit;
+
+/********************************************************************************
+ * returns the offset where a chunk starts. The even split is moved forward past
+ * utf-8 continuation bytes (at most 3) so a chunk never starts in the middle of
+ * a multi-byte character.
+ ********************************************************************************/
+static size_t chunk_start(const WCSplit* split, const size_t index)
+{
+    if (index >= split->num_chunks) { return split->size; }
+    size_t pos = split->size / split->num_chunks * index;
+    for (int i = 0; i < 3 && pos > 0 && pos < split->size && (split->data[pos] & 0xC0) == 0x80; i++) { pos++; }
+    return pos;
+}
+
+/*counts a chunk as if it was the start of a file, the words that straddle are fixed when merging*/
+static void wc_job_chunk(void* arg, const size_t index)
+{
+    WCSplit* split = arg;
+    const size_t start = chunk_start(split, index);
+    const size_t end = chunk_start(split, index + 1);
+    split->chunks[index] = (WCCounts){0, 0, 0, 0, false};
+    wc_count(&split->chunks[index], split->data + start, end - start);
+}
+
+/********************************************************************************
+ * merges the chunks in order. A chunk was counted starting outside a word, so
+ * the word that ends at its first byte is only counted when the previous chunk
+ * ended inside a word and the chunk starts with a whitespace.
+ ********************************************************************************/
+static WCCounts merge_chunks(const WCSplit* split)
+{
+    WCCounts counts = split->chunks[0];
+    for (size_t i = 1; i < split->num_chunks; i++)
+    {
+        const WCCounts* chunk = &split->chunks[i];
+        const size_t start = chunk_start(split, i);
+        if (start == chunk_start(split, i + 1)) { continue; } // empty chunk
+        counts.line_count += chunk->line_count;
+        counts.word_count += chunk->word_count + (counts.in_word && wc_is_whitespace(split->data[start]));
+        counts.char_count += chunk->char_count;
+        counts.byte_count += chunk->byte_count;
+        counts.in_word = chunk->in_word;
     }
-    return file;
+    return counts;
+}
+
+/*counts a large regular file on all the workers, anything else is counted by wc_file*/
+static WCFile wc_file_split(const int fd, const unsigned int jobs)
+{
+    struct stat st;
+    if (jobs < 2 || wc_counting == WC_COUNT_BYTES || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size < WC_SPLIT_MIN) { return wc_file(fd); }
+
+    WCSplit split = {NULL, st.st_size, (size_t)jobs * WC_CHUNKS_PER_JOB, NULL};
+    if (split.size / split.num_chunks < WC_CHUNK_MIN) { split.num_chunks = split.size / WC_CHUNK_MIN; }
+    void* data = mmap(NULL, split.size, PROT_READ, MAP_PRIVATE, fd, 0);
+    split.chunks = malloc(sizeof(WCCounts) * split.num_chunks);
+    if (data == MAP_FAILED || split.chunks == NULL)
+    {
+        if (data != MAP_FAILED) { munmap(data, split.size); }
+        free(split.chunks);
+        return wc_file(fd);
+    }
+    split.data = data;
+
+    wc_parallel_for(split.num_chunks, jobs, wc_job_chunk, &split);
+    const WCCounts counts = merge_chunks(&split);
+    munmap(data, split.size);
+    free(split.chunks);
+    return to_wc_file(&counts, true);
 }
 
 /*sets the flags, dupplicate flags have no side effects*/
@@ -85,45 +312,318 @@ static uint8_t set_wc_flags(const uint8_t flag, const char* flags)
 
 static void print_wc_result(const WCFile* file, const uint8_t flags, const char* file_name)
 {
-    if (flags&WC_LINE) { printf("%7d ", file->line_count); }
-    if (flags&WC_WORD) { printf("%7d ", file->word_count); }
-    if (flags&WC_CHAR) { printf("%7d ", file->char_count); }
-    if (flags&WC_BYTE) { printf("%7d ", file->byte_count); }
+    if (flags&WC_LINE) { printf("%7" PRIu64 " ", file->line_count); }
+    if (flags&WC_WORD) { printf("%7" PRIu64 " ", file->word_count); }
+    if (flags&WC_CHAR) { printf("%7" PRIu64 " ", file->char_count); }
+    if (flags&WC_BYTE) { printf("%7" PRIu64 " ", file->byte_count); }
     printf("%s\n", file_name);
 }
 
+/*prints the counts of a file, or the error if it could not be opened*/
+static void print_wc_file(const WCFile* file, const uint8_t flags, const char* file_name)
+{
+    if (file->error) { printf("[%s] No such file or directory.\n", file_name); }
+    else { print_wc_result(file, flags, file_name); }
+}
+
+static void add_to_totals(WCTotal* totals, const WCFile* file)
+{
+    totals->byte_count += file->byte_count;
+    totals->line_count += file->line_count;
+    totals->word_count += file->word_count;
+    totals->char_count += file->char_count;
+}
+
 static void print_wc_totals(const WCTotal* totals, const uint8_t flags)
 {
-    if (flags&WC_LINE) { printf("%7lu ", totals->line_count); }
-    if (flags&WC_WORD) { printf("%7lu ", totals->word_count); }
-    if (flags&WC_BYTE) { printf("%7lu ", totals->byte_count); }
-    if (flags&WC_CHAR) { printf("%7lu ", totals->char_count); }
+    if (flags&WC_LINE) { printf("%7" PRIu64 " ", totals->line_count); }
+    if (flags&WC_WORD) { printf("%7" PRIu64 " ", totals->word_count); }
+    if (flags&WC_CHAR) { printf("%7" PRIu64 " ", totals->char_count); }
+    if (flags&WC_BYTE) { printf("%7" PRIu64 " ", totals->byte_count); }
     printf("total\n");
 }
 
-static uint8_t min(const int x, const int y)
+/*a file from the arguments, the name points into argv*/
+typedef struct
+{
+    const char* name;
+    WCFile file;
+    bool deferred;
+} WCEntry;
+
+/*the files from the arguments, grown as files are found*/
+typedef struct
+{
+    size_t count;
+    size_t capacity;
+    WCEntry* entries;
+} WCFileTable;
+
+/*adds a file to the table, doubling it when full, returns false if out of memory*/
+static bool add_file(WCFileTable* table, const char* name)
 {
-    if (x < y) { return x; }
-    return y;
+    if (table->count == table->capacity)
+    {
+        const size_t capacity = table->capacity < 16 ? 16 : table->capacity * 2;
+        WCEntry* entries = realloc(table->entries, sizeof(WCEntry) * capacity);
+        if (entries == NULL) { return false; }
+        table->entries = entries;
+        table->capacity = capacity;
+    }
+    table->entries[table->count++] = (WCEntry){name, {false, 0, 0, 0, 0}, false};
+    return true;
 }
 
-int main(const int argc, const char* argv[])
+/*the files to count, shared with the workers of the pool*/
+typedef struct
 {
-    bool had_error = false;
-    uint8_t flags = WC_UNSET;
-    uint8_t num_files = 0; // arbitraty max num files to 256
-    uint8_t* indices = malloc(sizeof(uint8_t) * min(256, argc));
-    WCFile* files = malloc(sizeof(WCFile) * min(256, argc));
-    if (indices == NULL || files == NULL)
+    WCEntry* entries;
+    unsigned int jobs;
+} WCJob;
+
+/********************************************************************************
+ * opens and counts a single file, runs on a worker when -j is given. Files large
+ * enough to be split are deferred, they are counted one at a time on all the
+ * workers once the pool is done with the rest of the files.
+ ********************************************************************************/
+static void wc_job_file(void* arg, const size_t index)
+{
+    const WCJob* job = arg;
+    WCEntry* entry = &job->entries[index];
+    const int fd = open(entry->name, O_RDONLY);
+    if (fd < 0)
+    {
+        entry->file = (WCFile){true, 0, 0, 0, 0};
+        return;
+    }
+    struct stat st;
+    entry->deferred = job->jobs > 1 && wc_counting != WC_COUNT_BYTES && wc_state == NULL
+                   && fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size >= WC_SPLIT_MIN;
+    if (!entry->deferred) { entry->file = wc_named_file(entry->name, fd); }
+    close(fd);
+}
+
+/*counts the deferred files, each one split across all the workers*/
+static void wc_job_deferred(WCJob* job, const size_t num_files)
+{
+    for (size_t i = 0; i < num_files; i++)
+    {
+        WCEntry* entry = &job->entries[i];
+        if (!entry->deferred) { continue; }
+        const int fd = open(entry->name, O_RDONLY);
+        if (fd < 0)
+        {
+            entry->file = (WCFile){true, 0, 0, 0, 0};
+            continue;
+        }
+        entry->file = wc_file_split(fd, job->jobs);
+        close(fd);
+    }
+}
+
+/*the number of names in flight per worker when counting a file list*/
+#define WC_LIST_WINDOW_PER_JOB 8
+/*the number of files in flight on the ring with --async, and the workers per cpu when it falls back to the pool*/
+#define WC_ASYNC_WINDOW         64
+#define WC_ASYNC_JOBS_PER_CPU   4
+
+/*a file of the stream and its counts, the buffer holds the names read from a list and is reused*/
+typedef struct
+{
+    char* buffer;
+    size_t capacity;
+    const char* name;
+    WCFile file;
+} WCListSlot;
+
+/********************************************************************************
+ * the state of --files0-from and --files-from, or of the arguments with --async.
+ * The names are taken from the list (or the table) as they are needed and each
+ * result is printed as soon as it and every result before it are counted, so
+ * only the slots in flight are kept in memory.
+ ********************************************************************************/
+typedef struct
+{
+    FILE* list;
+    int delimiter;
+    const WCFileTable* table; // used instead of the list when it isn't NULL
+    size_t next_entry;
+    uint8_t flags;
+    WCListSlot* slots;
+    size_t num_files;
+    WCTotal totals;
+    bool had_error;
+} WCListJob;
+
+/*takes the next name from the table or reads it from the list into the slot, empty names are skipped*/
+static bool wc_list_next(void* arg, const size_t index)
+{
+    WCListJob* job = arg;
+    WCListSlot* slot = &job->slots[index];
+    if (job->table != NULL)
+    {
+        if (job->next_entry == job->table->count) { return false; }
+        slot->name = job->table->entries[job->next_entry++].name;
+        return true;
+    }
+    for (;;)
+    {
+        ssize_t len = getdelim(&slot->buffer, &slot->capacity, job->delimiter, job->list);
+        if (len < 0) { return false; }
+        if (len > 0 && slot->buffer[len - 1] == job->delimiter) { slot->buffer[--len] = '\0'; }
+        slot->name = slot->buffer;
+        if (len > 0) { return true; }
+    }
+}
+
+static void wc_list_count(void* arg, const size_t index)
+{
+    WCListSlot* slot = &((WCListJob*)arg)->slots[index];
+    const int fd = open(slot->name, O_RDONLY);
+    if (fd < 0)
+    {
+        slot->file = (WCFile){true, 0, 0, 0, 0};
+        return;
+    }
+    slot->file = wc_named_file(slot->name, fd);
+    close(fd);
+}
+
+static const char* wc_list_name(void* arg, const size_t index)
+{
+    return ((WCListJob*)arg)->slots[index].name;
+}
+
+/*receives the counts of a file counted on the ring*/
+static void wc_list_counted(void* arg, const size_t index, const WCCounts* counts, const bool counted)
+{
+    ((WCListJob*)arg)->slots[index].file = to_wc_file(counts, counted);
+}
+
+static void wc_list_print(void* arg, const size_t index)
+{
+    WCListJob* job = arg;
+    const WCListSlot* slot = &job->slots[index];
+    print_wc_file(&slot->file, job->flags, slot->name);
+    if (slot->file.error) { job->had_error = true; }
+    else { add_to_totals(&job->totals, &slot->file); }
+    job->num_files++;
+}
+
+/********************************************************************************
+ * counts the files of the job in order and prints the totals, returns false on
+ * error. With async the files are counted on io_uring, many opens and reads in
+ * flight at once, or on a pool with several workers per cpu if io_uring is not
+ * available (or --incremental needs the checkpoints).
+ ********************************************************************************/
+static bool wc_stream_files(WCListJob* job, unsigned int jobs, const bool async)
+{
+    if (async)
+    {
+        const unsigned int async_jobs = wc_num_cpus() * WC_ASYNC_JOBS_PER_CPU;
+        if (jobs < async_jobs) { jobs = async_jobs; }
+    }
+    size_t window = jobs > 1 ? (size_t)jobs * WC_LIST_WINDOW_PER_JOB : 1;
+    if (async && window < WC_ASYNC_WINDOW) { window = WC_ASYNC_WINDOW; }
+    job->slots = calloc(window, sizeof(WCListSlot));
+    if (job->slots == NULL)
     {
         fprintf(stderr, "malloc failed\n");
-        return 1;
+        return false;
     }
+
+    // with only -c a file is not read, fstat answers it without the ring
+    if (!async || wc_state != NULL || wc_counting == WC_COUNT_BYTES
+        || !wc_uring_stream(WC_ASYNC_WINDOW, wc_list_next, wc_list_name, wc_list_counted, wc_list_count, wc_list_print, job))
+    {
+        wc_parallel_stream(jobs, window, wc_list_next, wc_list_count, wc_list_print, job);
+    }
+    if (job->num_files > 1) { print_wc_totals(&job->totals, job->flags); }
+
+    for (size_t i = 0; i < window; i++) { free(job->slots[i].buffer); }
+    free(job->slots);
+    return !job->had_error;
+}
+
+/*counts every file named in the list, - reads the list from stdin, returns false on error*/
+static bool wc_list(const char* list_name, const int delimiter, const uint8_t flags, const unsigned int jobs, const bool async)
+{
+    FILE* list = strcmp(list_name, "-") == 0 ? stdin : fopen(list_name, "r");
+    if (list == NULL)
+    {
+        printf("[%s] No such file or directory.\n", list_name);
+        return false;
+    }
+    WCListJob job = {list, delimiter, NULL, 0, flags, NULL, 0, {0, 0, 0, 0}, false};
+    const bool ok = wc_stream_files(&job, jobs, async);
+    if (list != stdin) { fclose(list); }
+    return ok;
+}
+
+/*writes the checkpoints of --incremental and frees the state*/
+static bool save_state(WCState* state, const char* state_name)
+{
+    const bool saved = wc_state_save(state, state_name);
+    if (!saved) { fprintf(stderr, "[%s] Could not write the state file.\n", state_name); }
+    wc_state_free(state);
+    return saved;
+}
+
+/*the counts the kernel needs for the flags, the byte count is always known*/
+static unsigned int counts_for_flags(const uint8_t flags)
+{
+    unsigned int counts = WC_COUNT_BYTES;
+    if (flags&WC_LINE) { counts |= WC_COUNT_LINES; }
+    if (flags&WC_WORD) { counts |= WC_COUNT_WORDS; }
+    if (flags&WC_CHAR) { counts |= WC_COUNT_CHARS; }
+    return counts;
+}
+
+/*parses the number of jobs for -j N or -jN, 0 uses all cpus, returns 0 if invalid*/
+static unsigned int parse_jobs(const char* arg)
+{
+    char* end;
+    const long jobs = strtol(arg, &end, 10);
+    if (*arg == '\0' || *end != '\0' || jobs < 0 || jobs > 1024) { return 0; }
+    if (jobs == 0) { return wc_num_cpus(); }
+    return jobs;
+}
+
+int main(const int argc, const char* argv[])
+{
+    bool had_error = false;
+    uint8_t flags = WC_UNSET;
+    WCFileTable table = {0, 0, NULL};
     WCTotal totals = {0, 0, 0, 0};
 
+    unsigned int jobs = 1;
+    const char* list_name = NULL;
+    int list_delimiter = '\0';
+    const char* state_name = NULL;
+    WCState state;
+    bool async = false;
+
     for (int i = 1; i < argc; i++)
     {
-        if (argv[i][0] == '-')
+        if (strncmp(argv[i], "--files0-from=", 14) == 0 || strncmp(argv[i], "--files-from=", 13) == 0)
+        {
+            list_delimiter = argv[i][7] == '0' ? '\0' : '\n';
+            list_name = strchr(argv[i], '=') + 1;
+        }
+        else if (strncmp(argv[i], "--incremental=", 14) == 0) { state_name = argv[i] + 14; }
+        else if (strcmp(argv[i], "--async") == 0) { async = true; }
+        else if (argv[i][0] == '-' && argv[i][1] == 'j')
+        {
+            const char* value = argv[i] + 2;
+            if (*value == '\0' && i + 1 < argc) { value = argv[++i]; }
+            jobs = parse_jobs(value);
+            if (jobs == 0)
+            {
+                printf("invalid number of jobs [%s]\n", value);
+                return 1;
+            }
+        }
+        else if (argv[i][0] == '-')
         {
             if (flags&WC_UNSET) { flags = 0; }
             flags = set_wc_flags(flags, argv[i]);
@@ -135,61 +635,99 @@ int main(const int argc, const char* argv[])
         }
         else
         {
-            if (num_files + 1 == 256)
+            if (!add_file(&table, argv[i]))
             {
-                printf("Too many files\n");
+                fprintf(stderr, "malloc failed\n");
                 return 1;
             }
-            indices[num_files] = i;
-            FILE* stream = fopen(argv[i], "r");
-            if (stream == NULL)
-            {
-                had_error = true;
-                files[num_files] = (WCFile){true, 0, 0, 0, 0};
-            }
-            else
-            {
-                files[num_files] = wc_file(stream);
-                totals.byte_count += files[num_files].byte_count;
-                totals.line_count += files[num_files].line_count;
-                totals.word_count += files[num_files].word_count;
-                totals.char_count += files[num_files].char_count;
-                fclose(stream);
-            }
-            num_files++;
         }
     }
 
     if (flags&WC_UNSET) { flags = WC_DEFAULT; } // setting the proper bytes to 1 for the default setting
+    wc_counting = counts_for_flags(flags);
+    if (state_name != NULL)
+    {
+        wc_counting = WC_COUNT_ALL; // a checkpoint holds every count
+        if (!wc_state_load(&state, state_name))
+        {
+            fprintf(stderr, "[%s] Invalid state file, counting every file in full.\n", state_name);
+            wc_state_free(&state);
+            wc_state_load(&state, "/dev/null");
+        }
+        wc_state = &state;
+    }
+    wc_kernel_init(wc_counting);
+
+    if (list_name != NULL)
+    {
+        if (table.count > 0)
+        {
+            printf("files can't be combined with a file list\n");
+            return 1;
+        }
+        free(table.entries);
+        had_error = !wc_list(list_name, list_delimiter, flags, jobs, async);
+        if (wc_state != NULL && !save_state(wc_state, state_name)) { had_error = true; }
+        return had_error ? 1 : 0;
+    }
+
+    if (async && table.count > 0)
+    {
+        WCListJob list_job = {NULL, '\0', &table, 0, flags, NULL, 0, {0, 0, 0, 0}, false};
+        had_error = !wc_stream_files(&list_job, jobs, async);
+        if (wc_state != NULL && !save_state(wc_state, state_name)) { had_error = true; }
+        free(table.entries);
+        return had_error ? 1 : 0;
+    }
+
+    const size_t num_files = table.count;
+    WCJob job = {table.entries, jobs};
+    if (jobs > 1)
+    {
+        wc_parallel_for(num_files, jobs, wc_job_file, &job);
+        wc_job_deferred(&job, num_files);
+    }
+    else
+    {
+        for (size_t i = 0; i < num_files; i++) { wc_job_file(&job, i); }
+    }
+    for (size_t i = 0; i < num_files; i++)
+    {
+        const WCFile* file = &table.entries[i].file;
+        if (file->error)
+        {
+            had_error = true;
+            continue;
+        }
+        add_to_totals(&totals, file);
+    }
 
     switch (num_files)
     {
         case 0:
         {
-            WCFile file = wc_file(stdin);
+            WCFile file = wc_file_split(STDIN_FILENO, jobs);
             print_wc_result(&file, flags, "");
             break;
         }
         case 1:
         {
-            if (files[0].error) { printf("[%s] No such file or directory.\n", argv[indices[0]]); }
-            else { print_wc_result(&files[0], flags, argv[indices[0]]); }
+            print_wc_file(&table.entries[0].file, flags, table.entries[0].name);
             break;
         }
         default:
         {
-            for (int i = 0; i < num_files; i++)
+            for (size_t i = 0; i < num_files; i++)
             {
-                if (files[i].error) { printf("[%s] No such file or directory.\n", argv[indices[i]]); }
-                else { print_wc_result(&files[i], flags, argv[indices[i]]); }
+                print_wc_file(&table.entries[i].file, flags, table.entries[i].name);
             }
             print_wc_totals(&totals, flags);
             break;
         }
     }
 
-    free(indices); // not needed
-    free(files); // not needed
+    if (wc_state != NULL && !save_state(wc_state, state_name)) { had_error = true; }
+    free(table.entries); // not needed
     if (had_error) { return 1; }
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,186 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "wc_kernel.h"
+
+/********************************************************************************
+ * checks every kernel the cpu supports against the scalar kernel, for every
+ * combination of counts. Each input is counted in one call and split in two
+ * calls at every offset around the 64 byte block edges, starting from both
+ * word states, so the word carried between calls and the scalar tail are
+ * covered too. Run with make test, exits with 1 on the first mismatch.
+ ********************************************************************************/
+
+#define TEST_LEN 300
+
+static int failures = 0;
+
+static bool same_counts(const WCCounts* a, const WCCounts* b, const unsigned int what)
+{
+    if (a->byte_count != b->byte_count) { return false; }
+    if ((what & WC_COUNT_LINES) && a->line_count != b->line_count) { return false; }
+    if ((what & WC_COUNT_WORDS) && (a->word_count != b->word_count || a->in_word != b->in_word)) { return false; }
+    if ((what & WC_COUNT_CHARS) && a->char_count != b->char_count) { return false; }
+    return true;
+}
+
+static void report(const char* input, const WCKernelType type, const unsigned int what, const size_t len,
+                   const size_t split, const WCCounts* expected, const WCCounts* got)
+{
+    fprintf(stderr, "%s: %s kernel, counts %u, len %zu split at %zu: expected %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64
+            " got %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64 "\n", input, wc_kernel_name(type), what, len, split,
+            expected->line_count, expected->word_count, expected->char_count, expected->byte_count,
+            got->line_count, got->word_count, got->char_count, got->byte_count);
+    failures++;
+}
+
+/*counts the input with every kernel in one call and in two calls split at every offset*/
+static void check_input(const char* input, const unsigned char* data, const size_t len)
+{
+    for (unsigned int what = 0; what <= WC_COUNT_ALL; what++)
+    {
+        const WCKernel scalar = wc_kernel(WC_KERNEL_SCALAR, what);
+        for (int in_word = 0; in_word <= 1; in_word++)
+        {
+            WCCounts expected = {0, 0, 0, 0, in_word};
+            scalar(&expected, data, len);
+            for (int type = 0; type < WC_KERNEL_COUNT; type++)
+            {
+                const WCKernel kernel = wc_kernel(type, what);
+                if (kernel == NULL) { continue; }
+                for (size_t split = 0; split <= len; split++)
+                {
+                    WCCounts got = {0, 0, 0, 0, in_word};
+                    kernel(&got, data, split);
+                    kernel(&got, data + split, len - split);
+                    if (!same_counts(&expected, &got, what))
+                    {
+                        report(input, type, what, len, split, &expected, &got);
+                        return;
+                    }
+                }
+            }
+        }
+    }
+}
+
+/*checks the input at every alignment, so the blocks of the simd kernels start anywhere in it*/
+static void check(const char* input, const unsigned char* data, const size_t len)
+{
+    for (size_t start = 0; start < 64 && start < len; start += 7) { check_input(input, data + start, len - start); }
+}
+
+/********************************************************************************
+ * invalid utf-8 is counted as WCCounts says: a stray continuation byte is not a
+ * character, a truncated sequence is one, and an invalid lead byte (an overlong
+ * or surrogate form, or 0xf8 - 0xff) is one with its continuation bytes.
+ ********************************************************************************/
+typedef struct
+{
+    const char* name;
+    const char* bytes;
+    size_t len;
+    uint64_t chars;
+} CharCase;
+
+#define CHAR_CASE(name, bytes, chars) {name, bytes, sizeof(bytes) - 1, chars}
+
+static const CharCase char_cases[] = {
+    CHAR_CASE("valid 3 byte", "\xe2\x82\xac", 1),
+    CHAR_CASE("valid 4 byte", "\xf0\x9f\x98\x80", 1),
+    CHAR_CASE("lone continuation", "\x80", 0),
+    CHAR_CASE("lone continuations", "\x80\xbf\x80", 0),
+    CHAR_CASE("continuation between ascii", "a\xbf" "b", 2),
+    CHAR_CASE("truncated 2 byte", "\xc3", 1),
+    CHAR_CASE("truncated 3 byte", "\xe2\x82", 1),
+    CHAR_CASE("truncated 4 byte", "\xf0\x9f\x98", 1),
+    CHAR_CASE("truncated then ascii", "\xe2\x82z", 2),
+    CHAR_CASE("overlong 2 byte", "\xc0\xaf", 1),
+    CHAR_CASE("overlong 3 byte", "\xe0\x80\xaf", 1),
+    CHAR_CASE("overlong 4 byte", "\xf0\x80\x80\xaf", 1),
+    CHAR_CASE("high surrogate", "\xed\xa0\x80", 1),
+    CHAR_CASE("low surrogate", "\xed\xbf\xbf", 1),
+    CHAR_CASE("0xf8 - 0xff", "\xf8\xf9\xfa\xfb\xfc\xfd\xfe\xff", 8),
+    CHAR_CASE("5 byte form", "\xf8\x88\x80\x80\x80", 1),
+    CHAR_CASE("0xff and continuation", "\xff\x80", 1),
+};
+
+#define CHAR_CASE_BUFFER 200
+
+/********************************************************************************
+ * puts the case at every offset of a buffer of ascii, so it is cut at every
+ * block edge and truncated at the end of the buffer, and checks the characters
+ * every kernel counts in one call and split inside the case.
+ ********************************************************************************/
+static void check_char_case(const CharCase* test)
+{
+    unsigned char data[CHAR_CASE_BUFFER];
+    for (size_t at = 0; at + test->len <= CHAR_CASE_BUFFER; at++)
+    {
+        memset(data, 'a', CHAR_CASE_BUFFER);
+        memcpy(data + at, test->bytes, test->len);
+        const WCCounts expected = {0, 0, CHAR_CASE_BUFFER - test->len + test->chars, CHAR_CASE_BUFFER, false};
+        for (int type = 0; type < WC_KERNEL_COUNT; type++)
+        {
+            const WCKernel kernel = wc_kernel(type, WC_COUNT_CHARS);
+            if (kernel == NULL) { continue; }
+            for (size_t split = at; split <= at + test->len; split++)
+            {
+                WCCounts got = {0, 0, 0, 0, false};
+                kernel(&got, data, split);
+                kernel(&got, data + split, CHAR_CASE_BUFFER - split);
+                if (!same_counts(&expected, &got, WC_COUNT_CHARS))
+                {
+                    report(test->name, type, WC_COUNT_CHARS, CHAR_CASE_BUFFER, split, &expected, &got);
+                    return;
+                }
+            }
+        }
+    }
+}
+
+int main()
+{
+    unsigned char data[TEST_LEN];
+    srand(1);
+
+    // random bytes, and random bytes that are mostly whitespace and newlines
+    for (int round = 0; round < 20; round++)
+    {
+        for (size_t i = 0; i < TEST_LEN; i++) { data[i] = rand(); }
+        check("random", data, TEST_LEN);
+        static const char mix[] = " \n\t\rab\x80\xc3";
+        for (size_t i = 0; i < TEST_LEN; i++) { data[i] = mix[rand() % (sizeof(mix) - 1)]; }
+        check("random whitespace", data, TEST_LEN);
+    }
+
+    static const char whitespace[] = " \n\t\r";
+    for (size_t i = 0; i < TEST_LEN; i++) { data[i] = whitespace[i % 4]; }
+    check("whitespace only", data, TEST_LEN);
+    memset(data, '\n', TEST_LEN);
+    check("newlines only", data, TEST_LEN);
+    memset(data, 'a', TEST_LEN);
+    check("one word", data, TEST_LEN);
+
+    // the bytes with the high bit set, signed compares get them wrong
+    memset(data, 0x80, TEST_LEN);
+    check("0x80", data, TEST_LEN);
+    memset(data, 0xff, TEST_LEN);
+    check("0xff", data, TEST_LEN);
+    for (size_t i = 0; i < TEST_LEN; i++) { data[i] = 0x80 + i % 128; }
+    check("0x80 - 0xff", data, TEST_LEN);
+
+    // a word boundary right at every block edge
+    for (size_t i = 0; i < TEST_LEN; i++) { data[i] = i % 64 == 63 || i % 64 == 0 ? ' ' : 'a'; }
+    check("spaces at block edges", data, TEST_LEN);
+    for (size_t i = 0; i < TEST_LEN; i++) { data[i] = i % 32 == 31 ? '\n' : 'a'; }
+    check("newlines at half blocks", data, TEST_LEN);
+
+    for (size_t i = 0; i < sizeof(char_cases) / sizeof(char_cases[0]); i++) { check_char_case(&char_cases[i]); }
+
+    if (failures > 0) { return 1; }
+    printf("all kernels match the scalar kernel and count invalid utf-8 as documented\n");
+    return 0;
+}
@@ -0,0 +1,278 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "wc_kernel.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define WC_X86
+#include <immintrin.h>
+#endif
+
+/*each simd kernel counts 64 bytes at a time and leaves the tail to the scalar loop*/
+#define WC_BLOCK 64
+
+/*the number of specializations, one per combination of WC_COUNT_LINES, WC_COUNT_WORDS, and WC_COUNT_CHARS*/
+#define WC_SPECIALIZATIONS (WC_COUNT_ALL + 1)
+
+#define WC_INLINE static inline __attribute__((always_inline))
+
+/********************************************************************************
+ * defines the kernel name_N for every combination N of counts, each one calls
+ * the always inlined impl with a constant so the work for the counts that are
+ * not needed is compiled out. attr is the target of the kernel.
+ ********************************************************************************/
+#define WC_SPECIALIZE_ONE(name, impl, attr, what) \
+    attr static void name##_##what(WCCounts* counts, const unsigned char* block, const size_t len) \
+    { impl(counts, block, len, what); }
+
+#define WC_SPECIALIZE(name, impl, attr) \
+    WC_SPECIALIZE_ONE(name, impl, attr, 0) \
+    WC_SPECIALIZE_ONE(name, impl, attr, 1) \
+    WC_SPECIALIZE_ONE(name, impl, attr, 2) \
+    WC_SPECIALIZE_ONE(name, impl, attr, 3) \
+    WC_SPECIALIZE_ONE(name, impl, attr, 4) \
+    WC_SPECIALIZE_ONE(name, impl, attr, 5) \
+    WC_SPECIALIZE_ONE(name, impl, attr, 6) \
+    WC_SPECIALIZE_ONE(name, impl, attr, 7) \
+    static const WCKernel name[WC_SPECIALIZATIONS] = { \
+        name##_0, name##_1, name##_2, name##_3, name##_4, name##_5, name##_6, name##_7 \
+    };
+
+static const char* kernel_names[WC_KERNEL_COUNT] = {"scalar", "sse2", "avx2", "avx512"};
+
+static WCKernel selected;
+
+/*the reference kernel, branch free, every other kernel must match it*/
+WC_INLINE void count_scalar(WCCounts* counts, const unsigned char* block, const size_t len, const unsigned int what)
+{
+    bool word = counts->in_word;
+    uint64_t lines = 0;
+    uint64_t words = 0;
+    uint64_t chars = 0;
+    for (size_t i = 0; i < len; i++)
+    {
+        const unsigned char c = block[i];
+        if (what & WC_COUNT_LINES) { lines += c == '\n'; }
+        if (what & WC_COUNT_WORDS)
+        {
+            const bool space = wc_is_whitespace(c);
+            words += word & space;
+            word = !space;
+        }
+        if (what & WC_COUNT_CHARS) { chars += !wc_is_continuation(c); }
+    }
+    counts->line_count += lines;
+    counts->word_count += words;
+    counts->char_count += chars;
+    counts->byte_count += len;
+    counts->in_word = word;
+}
+
+WC_SPECIALIZE(scalar_kernels, count_scalar, )
+
+#ifdef WC_X86
+
+/********************************************************************************
+ * adds the counts of a 64 byte block given its newline, whitespace, and
+ * continuation masks, bit i of a mask is set if byte i matches. A word ends on
+ * every whitespace bit whose previous bit (the carry for bit 0) is not a
+ * whitespace.
+ ********************************************************************************/
+WC_INLINE void count_masks(WCCounts* block, const uint64_t newline, const uint64_t space, const uint64_t continuation,
+                           const unsigned int what)
+{
+    if (what & WC_COUNT_LINES) { block->line_count += __builtin_popcountll(newline); }
+    if (what & WC_COUNT_WORDS)
+    {
+        const uint64_t previous = (space << 1) | !block->in_word;
+        block->word_count += __builtin_popcountll(space & ~previous);
+        block->in_word = !(space >> 63);
+    }
+    if (what & WC_COUNT_CHARS) { block->char_count += WC_BLOCK - __builtin_popcountll(continuation); }
+}
+
+/*finishes a simd kernel, the tail that doesn't fill a block goes through the scalar kernel*/
+WC_INLINE void finish(WCCounts* counts, const WCCounts* blocks, const unsigned char* tail, const size_t tail_len,
+                      const size_t block_len, const unsigned int what)
+{
+    counts->line_count += blocks->line_count;
+    counts->word_count += blocks->word_count;
+    counts->char_count += blocks->char_count;
+    counts->byte_count += block_len;
+    counts->in_word = blocks->in_word;
+    count_scalar(counts, tail, tail_len, what);
+}
+
+/*movemask of the newline, whitespace, and continuation compares for 16 bytes*/
+WC_INLINE void masks_sse2(const unsigned char* p, uint64_t* newline, uint64_t* space, uint64_t* continuation,
+                          const unsigned int what)
+{
+    const __m128i v = _mm_loadu_si128((const __m128i*)p);
+    const __m128i nl = _mm_cmpeq_epi8(v, _mm_set1_epi8('\n'));
+    if (what & WC_COUNT_LINES) { *newline = (uint16_t)_mm_movemask_epi8(nl); }
+    if (what & WC_COUNT_WORDS)
+    {
+        const __m128i ws = _mm_or_si128(_mm_or_si128(nl, _mm_cmpeq_epi8(v, _mm_set1_epi8(' '))),
+                                        _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\t')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))));
+        *space = (uint16_t)_mm_movemask_epi8(ws);
+    }
+    if (what & WC_COUNT_CHARS)
+    {
+        const __m128i cont = _mm_cmplt_epi8(v, _mm_set1_epi8(-64)); // 0x80 - 0xbf are the only bytes below -64
+        *continuation = (uint16_t)_mm_movemask_epi8(cont);
+    }
+}
+
+WC_INLINE void count_sse2(WCCounts* counts, const unsigned char* block, const size_t len, const unsigned int what)
+{
+    WCCounts blocks = {0, 0, 0, 0, counts->in_word};
+    size_t i = 0;
+    if (what != WC_COUNT_BYTES)
+    {
+        for (; i + WC_BLOCK <= len; i += WC_BLOCK)
+        {
+            uint64_t newline = 0;
+            uint64_t space = 0;
+            uint64_t continuation = 0;
+            for (int j = 0; j < WC_BLOCK; j += 16)
+            {
+                uint64_t nl = 0, ws = 0, cont = 0;
+                masks_sse2(block + i + j, &nl, &ws, &cont, what);
+                newline |= nl << j;
+                space |= ws << j;
+                continuation |= cont << j;
+            }
+            count_masks(&blocks, newline, space, continuation, what);
+        }
+    }
+    finish(counts, &blocks, block + i, len - i, i, what);
+}
+
+WC_SPECIALIZE(sse2_kernels, count_sse2, )
+
+#define WC_AVX2 __attribute__((target("avx2,popcnt")))
+
+WC_AVX2 WC_INLINE void masks_avx2(const unsigned char* p, uint64_t* newline, uint64_t* space, uint64_t* continuation,
+                                  const unsigned int what)
+{
+    const __m256i v = _mm256_loadu_si256((const __m256i*)p);
+    const __m256i nl = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n'));
+    if (what & WC_COUNT_LINES) { *newline = (uint32_t)_mm256_movemask_epi8(nl); }
+    if (what & WC_COUNT_WORDS)
+    {
+        const __m256i ws = _mm256_or_si256(_mm256_or_si256(nl, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' '))),
+                                           _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t')),
+                                                           _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r'))));
+        *space = (uint32_t)_mm256_movemask_epi8(ws);
+    }
+    if (what & WC_COUNT_CHARS)
+    {
+        const __m256i cont = _mm256_cmpgt_epi8(_mm256_set1_epi8(-64), v);
+        *continuation = (uint32_t)_mm256_movemask_epi8(cont);
+    }
+}
+
+WC_AVX2 WC_INLINE void count_avx2(WCCounts* counts, const unsigned char* block, const size_t len, const unsigned int what)
+{
+    WCCounts blocks = {0, 0, 0, 0, counts->in_word};
+    size_t i = 0;
+    if (what != WC_COUNT_BYTES)
+    {
+        for (; i + WC_BLOCK <= len; i += WC_BLOCK)
+        {
+            uint64_t nl_lo = 0, ws_lo = 0, cont_lo = 0, nl_hi = 0, ws_hi = 0, cont_hi = 0;
+            masks_avx2(block + i, &nl_lo, &ws_lo, &cont_lo, what);
+            masks_avx2(block + i + 32, &nl_hi, &ws_hi, &cont_hi, what);
+            count_masks(&blocks, nl_lo | (nl_hi << 32), ws_lo | (ws_hi << 32), cont_lo | (cont_hi << 32), what);
+        }
+    }
+    finish(counts, &blocks, block + i, len - i, i, what);
+}
+
+WC_SPECIALIZE(avx2_kernels, count_avx2, WC_AVX2)
+
+#define WC_AVX512 __attribute__((target("avx512f,avx512bw,popcnt")))
+
+WC_AVX512 WC_INLINE void count_avx512(WCCounts* counts, const unsigned char* block, const size_t len, const unsigned int what)
+{
+    WCCounts blocks = {0, 0, 0, 0, counts->in_word};
+    size_t i = 0;
+    if (what != WC_COUNT_BYTES)
+    {
+        for (; i + WC_BLOCK <= len; i += WC_BLOCK)
+        {
+            const __m512i v = _mm512_loadu_si512((const void*)(block + i));
+            const uint64_t newline = _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8('\n'));
+            uint64_t space = 0;
+            uint64_t continuation = 0;
+            if (what & WC_COUNT_WORDS)
+            {
+                space = newline
+                      | _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8(' '))
+                      | _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8('\t'))
+                      | _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8('\r'));
+            }
+            if (what & WC_COUNT_CHARS) { continuation = _mm512_cmplt_epi8_mask(v, _mm512_set1_epi8(-64)); }
+            count_masks(&blocks, newline, space, continuation, what);
+        }
+    }
+    finish(counts, &blocks, block + i, len - i, i, what);
+}
+
+WC_SPECIALIZE(avx512_kernels, count_avx512, WC_AVX512)
+
+#endif
+
+WCKernel wc_kernel(const WCKernelType type, const unsigned int counts)
+{
+    const unsigned int what = counts & WC_COUNT_ALL;
+    switch (type)
+    {
+        case WC_KERNEL_SCALAR: return scalar_kernels[what];
+#ifdef WC_X86
+        case WC_KERNEL_SSE2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("sse2") ? sse2_kernels[what] : NULL;
+        case WC_KERNEL_AVX2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt") ? avx2_kernels[what] : NULL;
+        case WC_KERNEL_AVX512:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("popcnt") ? avx512_kernels[what] : NULL;
+#endif
+        default: return NULL;
+    }
+}
+
+const char* wc_kernel_name(const WCKernelType type)
+{
+    if (type < 0 || type >= WC_KERNEL_COUNT) { return "unknown"; }
+    return kernel_names[type];
+}
+
+/*picks the fastest kernel the cpu supports unless CCWC_KERNEL forces one*/
+void wc_kernel_init(const unsigned int counts)
+{
+    const char* forced = getenv("CCWC_KERNEL");
+    if (forced != NULL)
+    {
+        for (int type = 0; type < WC_KERNEL_COUNT; type++)
+        {
+            if (strcmp(forced, kernel_names[type]) == 0 && wc_kernel(type, counts) != NULL)
+            {
+                selected = wc_kernel(type, counts);
+                return;
+            }
+        }
+    }
+    for (int type = WC_KERNEL_COUNT - 1; type >= 0; type--)
+    {
+        selected = wc_kernel(type, counts);
+        if (selected != NULL) { return; }
+    }
+}
+
+void wc_count(WCCounts* counts, const unsigned char* block, const size_t len)
+{
+    selected(counts, block, len);
+}
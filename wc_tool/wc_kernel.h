@@ -0,0 +1,79 @@
+#ifndef WC_KERNEL_H
+#define WC_KERNEL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/********************************************************************************
+ * The running counts of a stream. in_word is the word state after the last
+ * byte counted, it is carried into the next block so a word that spans two
+ * blocks is only counted once. A word is counted when it ends, that is when a
+ * whitespace follows a non whitespace.
+ * Characters are utf-8 code points, every byte that is not a continuation byte
+ * (10xxxxxx) starts a character. Invalid input is counted by the same rule: a
+ * stray continuation byte is not a character, a truncated sequence is one
+ * character, and an invalid lead byte is one character.
+ ********************************************************************************/
+typedef struct
+{
+    uint64_t line_count;
+    uint64_t word_count;
+    uint64_t char_count;
+    uint64_t byte_count;
+    bool in_word;
+} WCCounts;
+
+/*whitespace = space, newline, tab, and return*/
+static inline bool wc_is_whitespace(const unsigned char c)
+{
+    return c == ' ' || c == '\n'  || c == '\t' || c == '\r';
+}
+
+/*a utf-8 continuation byte doesn't start a character*/
+static inline bool wc_is_continuation(const unsigned char c)
+{
+    return (c & 0xC0) == 0x80;
+}
+
+/*a counting kernel, adds the counts of the block to counts*/
+typedef void (*WCKernel)(WCCounts* counts, const unsigned char* block, size_t len);
+
+/********************************************************************************
+ * what a kernel counts. Every combination has its own kernel that only does the
+ * work for those counts, the counts it doesn't cover are left as they were
+ * (in_word is only kept when counting words). Bytes are always counted.
+ ********************************************************************************/
+#define WC_COUNT_BYTES 0u
+#define WC_COUNT_LINES (1u << 0)
+#define WC_COUNT_WORDS (1u << 1)
+#define WC_COUNT_CHARS (1u << 2)
+#define WC_COUNT_ALL   (WC_COUNT_LINES | WC_COUNT_WORDS | WC_COUNT_CHARS)
+
+/*the kernels, a kernel is only available if the cpu supports it*/
+typedef enum
+{
+    WC_KERNEL_SCALAR,
+    WC_KERNEL_SSE2,
+    WC_KERNEL_AVX2,
+    WC_KERNEL_AVX512,
+    WC_KERNEL_COUNT
+} WCKernelType;
+
+/********************************************************************************
+ * picks the fastest kernel the cpu supports for the counts given (WC_COUNT_*),
+ * must be called once before wc_count. The CCWC_KERNEL environment variable
+ * (scalar, sse2, avx2, avx512) forces a kernel, it is ignored if the cpu does
+ * not support it.
+ ********************************************************************************/
+void wc_kernel_init(unsigned int counts);
+
+/*counts a block with the kernel picked by wc_kernel_init*/
+void wc_count(WCCounts* counts, const unsigned char* block, size_t len);
+
+/*returns the kernel for the counts given or NULL if the cpu does not support it*/
+WCKernel wc_kernel(WCKernelType type, unsigned int counts);
+
+const char* wc_kernel_name(WCKernelType type);
+
+#endif
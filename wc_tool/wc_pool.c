@@ -0,0 +1,170 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "wc_pool.h"
+
+/*shared by the workers of a single wc_parallel_for call*/
+typedef struct
+{
+    atomic_size_t next;
+    size_t count;
+    WCTask task;
+    void* arg;
+} WCPool;
+
+/*takes the next index until there are none left*/
+static void* worker(void* data)
+{
+    WCPool* pool = data;
+    for (;;)
+    {
+        const size_t index = atomic_fetch_add_explicit(&pool->next, 1, memory_order_relaxed);
+        if (index >= pool->count) { return NULL; }
+        pool->task(pool->arg, index);
+    }
+}
+
+bool wc_parallel_for(const size_t count, unsigned int num_threads, const WCTask task, void* arg)
+{
+    WCPool pool = {0, count, task, arg};
+    if (num_threads > count) { num_threads = count; }
+    if (num_threads <= 1)
+    {
+        worker(&pool);
+        return true;
+    }
+
+    pthread_t* threads = malloc(sizeof(pthread_t) * (num_threads - 1));
+    unsigned int started = 0;
+    if (threads != NULL)
+    {
+        while (started < num_threads - 1 && pthread_create(&threads[started], NULL, worker, &pool) == 0) { started++; }
+    }
+    worker(&pool); // the calling thread is one of the workers
+    for (unsigned int i = 0; i < started; i++) { pthread_join(threads[i], NULL); }
+    free(threads);
+    return started > 0;
+}
+
+/*shared by the workers of a single wc_parallel_stream call, guarded by lock*/
+typedef struct
+{
+    pthread_mutex_t lock;
+    pthread_cond_t work; // signaled when an item is produced or the stream ends
+    pthread_cond_t finished; // signaled when a worker finishes an item
+    size_t window;
+    size_t produced;
+    size_t claimed;
+    bool* done;
+    bool ended;
+    WCTask task;
+    void* arg;
+} WCStream;
+
+/*takes the oldest unclaimed item until the stream ends*/
+static void* stream_worker(void* data)
+{
+    WCStream* stream = data;
+    pthread_mutex_lock(&stream->lock);
+    for (;;)
+    {
+        while (stream->claimed == stream->produced && !stream->ended) { pthread_cond_wait(&stream->work, &stream->lock); }
+        if (stream->claimed == stream->produced) { break; }
+        const size_t slot = stream->claimed++ % stream->window;
+        pthread_mutex_unlock(&stream->lock);
+        stream->task(stream->arg, slot);
+        pthread_mutex_lock(&stream->lock);
+        stream->done[slot] = true;
+        pthread_cond_signal(&stream->finished);
+    }
+    pthread_mutex_unlock(&stream->lock);
+    return NULL;
+}
+
+/*runs the stream on the calling thread only*/
+static void stream_serial(const WCProducer next, const WCTask task, const WCTask done, void* arg)
+{
+    while (next(arg, 0))
+    {
+        task(arg, 0);
+        done(arg, 0);
+    }
+}
+
+bool wc_parallel_stream(const unsigned int num_threads, const size_t window, const WCProducer next, const WCTask task,
+                        const WCTask done, void* arg)
+{
+    if (num_threads <= 1 || window == 0)
+    {
+        stream_serial(next, task, done, arg);
+        return true;
+    }
+    WCStream stream = {.window = window, .produced = 0, .claimed = 0, .ended = false, .task = task, .arg = arg};
+    stream.done = calloc(window, sizeof(bool));
+    pthread_t* threads = malloc(sizeof(pthread_t) * num_threads);
+    if (stream.done == NULL || threads == NULL)
+    {
+        free(stream.done);
+        free(threads);
+        stream_serial(next, task, done, arg);
+        return false;
+    }
+    pthread_mutex_init(&stream.lock, NULL);
+    pthread_cond_init(&stream.work, NULL);
+    pthread_cond_init(&stream.finished, NULL);
+    unsigned int started = 0;
+    while (started < num_threads && pthread_create(&threads[started], NULL, stream_worker, &stream) == 0) { started++; }
+    if (started == 0) { stream.ended = true; } // nothing to hand the items to
+
+    size_t consumed = 0;
+    pthread_mutex_lock(&stream.lock);
+    for (;;)
+    {
+        // hand out the finished items in order before producing more
+        if (consumed < stream.produced && stream.done[consumed % window])
+        {
+            const size_t slot = consumed % window;
+            stream.done[slot] = false;
+            pthread_mutex_unlock(&stream.lock);
+            done(arg, slot);
+            pthread_mutex_lock(&stream.lock);
+            consumed++;
+            continue;
+        }
+        if (!stream.ended && stream.produced - consumed < window)
+        {
+            pthread_mutex_unlock(&stream.lock);
+            const bool produced = next(arg, stream.produced % window); // only this thread changes produced
+            pthread_mutex_lock(&stream.lock);
+            if (produced) { stream.produced++; }
+            else { stream.ended = true; }
+            pthread_cond_broadcast(&stream.work);
+            continue;
+        }
+        if (stream.ended && consumed == stream.produced) { break; }
+        pthread_cond_wait(&stream.finished, &stream.lock);
+    }
+    pthread_mutex_unlock(&stream.lock);
+
+    for (unsigned int i = 0; i < started; i++) { pthread_join(threads[i], NULL); }
+    pthread_cond_destroy(&stream.finished);
+    pthread_cond_destroy(&stream.work);
+    pthread_mutex_destroy(&stream.lock);
+    free(stream.done);
+    free(threads);
+    if (started == 0)
+    {
+        stream_serial(next, task, done, arg);
+        return false;
+    }
+    return true;
+}
+
+unsigned int wc_num_cpus()
+{
+    const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus < 1) { return 1; }
+    return cpus;
+}
@@ -0,0 +1,39 @@
+#ifndef WC_POOL_H
+#define WC_POOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*a task of the pool, called once for every index*/
+typedef void (*WCTask)(void* arg, size_t index);
+
+/********************************************************************************
+ * runs task(arg, index) for every index below count on a pool of up to
+ * num_threads worker threads and returns once all the tasks are done. The
+ * workers take the next index as soon as they are free, so tasks of very
+ * different sizes still keep every worker busy. The tasks run in no particular
+ * order, a task must only write to the results of its own index.
+ * Returns false if no worker could be started, the tasks are then run on the
+ * calling thread.
+ ********************************************************************************/
+bool wc_parallel_for(size_t count, unsigned int num_threads, WCTask task, void* arg);
+
+/*fills the slot with the next item of a stream, returns false when the stream has ended*/
+typedef bool (*WCProducer)(void* arg, size_t slot);
+
+/********************************************************************************
+ * runs a stream of items of unknown length through a pool of num_threads
+ * workers, using window slots. The calling thread calls next to fill a free
+ * slot, a worker calls task on the slot, and then the calling thread calls done
+ * on the slots in the order the items were produced, as soon as the oldest item
+ * is finished. At most window items are in flight, so the memory used does not
+ * depend on the length of the stream. next and done always run on the calling
+ * thread. Returns false if no worker could be started, the items are then run
+ * on the calling thread one at a time.
+ ********************************************************************************/
+bool wc_parallel_stream(unsigned int num_threads, size_t window, WCProducer next, WCTask task, WCTask done, void* arg);
+
+/*the number of online cpus, at least 1*/
+unsigned int wc_num_cpus();
+
+#endif
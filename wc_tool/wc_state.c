@@ -0,0 +1,221 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "wc_state.h"
+
+/********************************************************************************
+ * The state file has a record per file:
+ * dev ino offset head_len head_hash in_word lines words chars bytes path_len path
+ * followed by a newline. The path is path_len bytes after exactly one space and
+ * is written as it is, so it can start with a space or hold a newline.
+ ********************************************************************************/
+#define WC_STATE_FORMAT "%" SCNu64 " %" SCNu64 " %" SCNu64 " %" SCNu64 " %" SCNx64 " %d %" SCNu64 " %" SCNu64 " %" SCNu64 " %" SCNu64 " %zu"
+
+static int compare_checkpoints(const void* a, const void* b)
+{
+    return strcmp(((const WCCheckpoint*)a)->path, ((const WCCheckpoint*)b)->path);
+}
+
+/********************************************************************************
+ * the updates sorted by path, and the updates of the same path (a file given
+ * twice, counted on two workers in no set order) by how far they counted and
+ * then by inode, so the one written is the furthest one whatever the order.
+ ********************************************************************************/
+static int compare_updates(const void* a, const void* b)
+{
+    const WCCheckpoint* x = a;
+    const WCCheckpoint* y = b;
+    const int order = strcmp(x->path, y->path);
+    if (order != 0) { return order; }
+    if (x->offset != y->offset) { return x->offset < y->offset ? -1 : 1; }
+    if (x->ino != y->ino) { return x->ino < y->ino ? -1 : 1; }
+    return x->dev < y->dev ? -1 : x->dev > y->dev;
+}
+
+/*the end of the state file or a corrupt record*/
+typedef enum
+{
+    WC_RECORD_OK,
+    WC_RECORD_END,
+    WC_RECORD_CORRUPT
+} WCRecord;
+
+/*reads the next record of the state file, the path is allocated for the checkpoint*/
+static WCRecord read_checkpoint(FILE* file, WCCheckpoint* checkpoint)
+{
+    int in_word = 0;
+    size_t path_len = 0;
+    const int fields = fscanf(file, WC_STATE_FORMAT, &checkpoint->dev, &checkpoint->ino, &checkpoint->offset,
+                              &checkpoint->head_len, &checkpoint->head_hash, &in_word, &checkpoint->counts.line_count,
+                              &checkpoint->counts.word_count, &checkpoint->counts.char_count,
+                              &checkpoint->counts.byte_count, &path_len);
+    if (fields == EOF) { return WC_RECORD_END; }
+    if (fields != 11 || path_len == 0 || getc(file) != ' ') { return WC_RECORD_CORRUPT; }
+    checkpoint->counts.in_word = in_word != 0;
+    checkpoint->path = malloc(path_len + 1);
+    if (checkpoint->path == NULL) { return WC_RECORD_CORRUPT; }
+    if (fread(checkpoint->path, 1, path_len, file) != path_len || getc(file) != '\n'
+        || memchr(checkpoint->path, '\0', path_len) != NULL)
+    {
+        free(checkpoint->path);
+        return WC_RECORD_CORRUPT;
+    }
+    checkpoint->path[path_len] = '\0';
+    return WC_RECORD_OK;
+}
+
+bool wc_state_load(WCState* state, const char* path)
+{
+    *state = (WCState){.loaded = NULL, .num_loaded = 0, .updated = NULL, .num_updated = 0, .capacity = 0};
+    pthread_mutex_init(&state->lock, NULL);
+    FILE* file = fopen(path, "r");
+    if (file == NULL) { return true; } // the first run
+
+    size_t capacity = 0;
+    bool ok = true;
+    for (;;)
+    {
+        WCCheckpoint checkpoint;
+        const WCRecord record = read_checkpoint(file, &checkpoint);
+        if (record != WC_RECORD_OK)
+        {
+            ok = record == WC_RECORD_END;
+            break;
+        }
+        if (state->num_loaded == capacity)
+        {
+            capacity = capacity < 64 ? 64 : capacity * 2;
+            WCCheckpoint* loaded = realloc(state->loaded, sizeof(WCCheckpoint) * capacity);
+            if (loaded == NULL)
+            {
+                free(checkpoint.path);
+                ok = false;
+                break;
+            }
+            state->loaded = loaded;
+        }
+        state->loaded[state->num_loaded++] = checkpoint;
+    }
+    fclose(file);
+    qsort(state->loaded, state->num_loaded, sizeof(WCCheckpoint), compare_checkpoints);
+    return ok;
+}
+
+const WCCheckpoint* wc_state_find(const WCState* state, const char* path)
+{
+    const WCCheckpoint key = {.path = (char*)path};
+    return bsearch(&key, state->loaded, state->num_loaded, sizeof(WCCheckpoint), compare_checkpoints);
+}
+
+bool wc_state_update(WCState* state, const WCCheckpoint* checkpoint)
+{
+    char* path = strdup(checkpoint->path);
+    if (path == NULL) { return false; }
+
+    pthread_mutex_lock(&state->lock);
+    if (state->num_updated == state->capacity)
+    {
+        const size_t capacity = state->capacity < 64 ? 64 : state->capacity * 2;
+        WCCheckpoint* updated = realloc(state->updated, sizeof(WCCheckpoint) * capacity);
+        if (updated == NULL)
+        {
+            pthread_mutex_unlock(&state->lock);
+            free(path);
+            return false;
+        }
+        state->updated = updated;
+        state->capacity = capacity;
+    }
+    state->updated[state->num_updated] = *checkpoint;
+    state->updated[state->num_updated++].path = path;
+    pthread_mutex_unlock(&state->lock);
+    return true;
+}
+
+static void write_checkpoint(FILE* file, const WCCheckpoint* checkpoint)
+{
+    fprintf(file, "%" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIx64 " %d %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64 " %zu %s\n",
+            checkpoint->dev, checkpoint->ino, checkpoint->offset, checkpoint->head_len, checkpoint->head_hash,
+            checkpoint->counts.in_word, checkpoint->counts.line_count, checkpoint->counts.word_count,
+            checkpoint->counts.char_count, checkpoint->counts.byte_count, strlen(checkpoint->path), checkpoint->path);
+}
+
+bool wc_state_save(WCState* state, const char* path)
+{
+    const size_t path_len = strlen(path);
+    char* temp = malloc(path_len + 5);
+    if (temp == NULL) { return false; }
+    memcpy(temp, path, path_len);
+    memcpy(temp + path_len, ".tmp", 5);
+
+    FILE* file = fopen(temp, "w");
+    if (file == NULL)
+    {
+        free(temp);
+        return false;
+    }
+    // the updates are sorted too so both lists are merged in one pass, an update replaces the loaded checkpoint
+    qsort(state->updated, state->num_updated, sizeof(WCCheckpoint), compare_updates);
+    size_t i = 0;
+    size_t j = 0;
+    while (i < state->num_loaded || j < state->num_updated)
+    {
+        const int order = i == state->num_loaded ? 1
+                        : j == state->num_updated ? -1
+                        : compare_checkpoints(&state->loaded[i], &state->updated[j]);
+        if (order < 0)
+        {
+            // a file that wasn't counted this run is kept only while it is still there
+            struct stat st;
+            if (stat(state->loaded[i].path, &st) == 0) { write_checkpoint(file, &state->loaded[i]); }
+            i++;
+        }
+        else
+        {
+            if (order == 0) { i++; }
+            // the same file given twice has two updates, they are sorted so the furthest one is last
+            while (j + 1 < state->num_updated && compare_checkpoints(&state->updated[j], &state->updated[j + 1]) == 0) { j++; }
+            write_checkpoint(file, &state->updated[j++]);
+        }
+    }
+    bool ok = fflush(file) == 0 && fsync(fileno(file)) == 0;
+    ok = fclose(file) == 0 && ok;
+    ok = ok && rename(temp, path) == 0;
+    if (!ok) { unlink(temp); }
+    free(temp);
+    return ok;
+}
+
+void wc_state_free(WCState* state)
+{
+    for (size_t i = 0; i < state->num_loaded; i++) { free(state->loaded[i].path); }
+    for (size_t i = 0; i < state->num_updated; i++) { free(state->updated[i].path); }
+    free(state->loaded);
+    free(state->updated);
+    pthread_mutex_destroy(&state->lock);
+}
+
+bool wc_head_hash(const int fd, const uint64_t len, uint64_t* hash)
+{
+    unsigned char head[WC_HEAD_LEN];
+    if (len > WC_HEAD_LEN) { return false; }
+    size_t done = 0;
+    while (done < len)
+    {
+        const ssize_t got = pread(fd, head + done, len - done, done);
+        if (got <= 0) { return false; }
+        done += got;
+    }
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < len; i++)
+    {
+        h ^= head[i];
+        h *= 0x100000001b3ULL;
+    }
+    *hash = h;
+    return true;
+}
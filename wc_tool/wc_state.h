@@ -0,0 +1,67 @@
+#ifndef WC_STATE_H
+#define WC_STATE_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "wc_kernel.h"
+
+/********************************************************************************
+ * The checkpoint of a file for --incremental. offset is how far the file was
+ * counted and counts (with in_word) are the counts up to offset, so the next
+ * run only counts what was appended after it. The file is only continued if it
+ * is still the same file: same device and inode, not shorter than offset, and
+ * the first head_len bytes still hash to head_hash (this catches a file that
+ * was truncated and grew back past offset).
+ ********************************************************************************/
+typedef struct
+{
+    uint64_t dev;
+    uint64_t ino;
+    uint64_t offset;
+    uint64_t head_len;
+    uint64_t head_hash;
+    WCCounts counts;
+    char* path;
+} WCCheckpoint;
+
+/*the bytes at the start of a file that are hashed to recognize it*/
+#define WC_HEAD_LEN 4096
+
+/*the checkpoints loaded from the state file, sorted by path, and the ones updated by this run*/
+typedef struct
+{
+    WCCheckpoint* loaded;
+    size_t num_loaded;
+    WCCheckpoint* updated;
+    size_t num_updated;
+    size_t capacity;
+    pthread_mutex_t lock;
+} WCState;
+
+/*loads the state file, a missing file is an empty state, returns false if the file is corrupt*/
+bool wc_state_load(WCState* state, const char* path);
+
+/*returns the checkpoint of a file from the last run or NULL*/
+const WCCheckpoint* wc_state_find(const WCState* state, const char* path);
+
+/*records the new checkpoint of a file, safe to call from the workers, returns false if out of memory*/
+bool wc_state_update(WCState* state, const WCCheckpoint* checkpoint);
+
+/********************************************************************************
+ * writes every checkpoint, the updated ones replace the loaded ones of the same
+ * path, and of two updates of the same path the one that counted furthest is
+ * kept. A loaded checkpoint whose path no longer exists is dropped. The file is
+ * written next to the state file and renamed over it so a crash never leaves a
+ * half written state. Returns false on error.
+ ********************************************************************************/
+bool wc_state_save(WCState* state, const char* path);
+
+void wc_state_free(WCState* state);
+
+/*hashes the first len bytes of the file (FNV-1a), returns false if they can't be read*/
+bool wc_head_hash(int fd, uint64_t len, uint64_t* hash);
+
+#endif
@@ -0,0 +1,390 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "wc_uring.h"
+
+#ifdef __linux__
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/*the read size of a file in flight, most small files are read in one go*/
+#define WC_URING_BUFFER (64u << 10)
+
+/*the rings shared with the kernel, the pointers point into the mappings*/
+typedef struct
+{
+    int fd;
+    unsigned int* sq_head;
+    unsigned int* sq_tail;
+    unsigned int* sq_mask;
+    unsigned int* sq_array;
+    unsigned int sq_entries;
+    struct io_uring_sqe* sqes;
+    unsigned int* cq_head;
+    unsigned int* cq_tail;
+    unsigned int* cq_mask;
+    struct io_uring_cqe* cqes;
+    void* sq_ring;
+    size_t sq_ring_size;
+    void* cq_ring;
+    size_t cq_ring_size;
+    size_t sqes_size;
+    unsigned int pending; // queued but not yet submitted
+    unsigned int in_flight; // submitted but not yet completed
+    bool current_position; // a read at offset -1 reads from the file position, needed for pipes
+} WCRing;
+
+typedef enum
+{
+    SLOT_FREE,
+    SLOT_OPENING,
+    SLOT_READING,
+    SLOT_CLOSING,
+    SLOT_FINISHED
+} WCSlotState;
+
+/*a file in flight*/
+typedef struct
+{
+    WCSlotState state;
+    int fd;
+    uint64_t offset;
+    WCCounts counts;
+    unsigned char* buffer;
+} WCUringSlot;
+
+static int ring_setup(unsigned int entries, struct io_uring_params* params)
+{
+    return syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int ring_enter(const int fd, const unsigned int to_submit, const unsigned int min_complete)
+{
+    return syscall(__NR_io_uring_enter, fd, to_submit, min_complete, IORING_ENTER_GETEVENTS, NULL, 0);
+}
+
+/*true if the kernel supports every operation a file needs*/
+static bool ring_supports_ops(const int fd)
+{
+    const size_t size = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe* probe = calloc(1, size);
+    if (probe == NULL) { return false; }
+    bool supported = syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, 256) == 0;
+    const int ops[] = {IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_CLOSE};
+    for (int i = 0; supported && i < 3; i++)
+    {
+        supported = ops[i] <= probe->last_op && (probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED);
+    }
+    free(probe);
+    return supported;
+}
+
+static void ring_free(WCRing* ring)
+{
+    if (ring->sqes != NULL) { munmap(ring->sqes, ring->sqes_size); }
+    if (ring->cq_ring != NULL && ring->cq_ring != ring->sq_ring) { munmap(ring->cq_ring, ring->cq_ring_size); }
+    if (ring->sq_ring != NULL) { munmap(ring->sq_ring, ring->sq_ring_size); }
+    close(ring->fd);
+}
+
+static bool ring_init(WCRing* ring, const unsigned int entries)
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = ring_setup(entries, &params);
+    if (ring->fd < 0) { return false; }
+    if (!ring_supports_ops(ring->fd))
+    {
+        close(ring->fd);
+        return false;
+    }
+
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    const bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap)
+    {
+        if (ring->cq_ring_size > ring->sq_ring_size) { ring->sq_ring_size = ring->cq_ring_size; }
+        ring->cq_ring_size = ring->sq_ring_size;
+    }
+    void* sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if (sq_ring == MAP_FAILED)
+    {
+        close(ring->fd);
+        return false;
+    }
+    ring->sq_ring = sq_ring;
+    void* cq_ring = sq_ring;
+    if (!single_mmap)
+    {
+        cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+        if (cq_ring == MAP_FAILED)
+        {
+            ring_free(ring);
+            return false;
+        }
+    }
+    ring->cq_ring = cq_ring;
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    void* sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED)
+    {
+        ring_free(ring);
+        return false;
+    }
+    ring->sqes = sqes;
+
+    unsigned char* sq = sq_ring;
+    unsigned char* cq = cq_ring;
+    ring->sq_head = (unsigned int*)(sq + params.sq_off.head);
+    ring->sq_tail = (unsigned int*)(sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned int*)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned int*)(sq + params.sq_off.array);
+    ring->sq_entries = params.sq_entries;
+    ring->cq_head = (unsigned int*)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned int*)(cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned int*)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+    ring->current_position = params.features & IORING_FEAT_RW_CUR_POS;
+    return true;
+}
+
+/*queues an operation for the slot, there is always room since every slot has at most one in flight*/
+static void ring_queue(WCRing* ring, const struct io_uring_sqe* sqe)
+{
+    const unsigned int tail = *ring->sq_tail;
+    const unsigned int index = tail & *ring->sq_mask;
+    ring->sqes[index] = *sqe;
+    ring->sq_array[index] = index;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ring->pending++;
+}
+
+/*submits the queued operations and waits for at least one completion, returns false if the ring failed*/
+static bool ring_submit_and_wait(WCRing* ring)
+{
+    for (;;)
+    {
+        const int submitted = ring_enter(ring->fd, ring->pending, 1);
+        if (submitted >= 0)
+        {
+            ring->pending -= submitted;
+            ring->in_flight += submitted;
+            return true;
+        }
+        if (errno != EINTR && errno != EAGAIN && errno != EBUSY) { return false; }
+    }
+}
+
+static void queue_open(WCRing* ring, const size_t slot, const char* name)
+{
+    struct io_uring_sqe sqe;
+    memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = IORING_OP_OPENAT;
+    sqe.fd = AT_FDCWD;
+    sqe.addr = (uintptr_t)name;
+    sqe.open_flags = O_RDONLY;
+    sqe.user_data = slot;
+    ring_queue(ring, &sqe);
+}
+
+static void queue_read(WCRing* ring, const size_t slot, WCUringSlot* file)
+{
+    struct io_uring_sqe sqe;
+    memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = IORING_OP_READ;
+    sqe.fd = file->fd;
+    sqe.addr = (uintptr_t)file->buffer;
+    sqe.len = WC_URING_BUFFER;
+    sqe.off = ring->current_position ? (uint64_t)-1 : file->offset;
+    sqe.user_data = slot;
+    ring_queue(ring, &sqe);
+}
+
+static void queue_close(WCRing* ring, const size_t slot, const int fd)
+{
+    struct io_uring_sqe sqe;
+    memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = IORING_OP_CLOSE;
+    sqe.fd = fd;
+    sqe.user_data = slot;
+    ring_queue(ring, &sqe);
+}
+
+/*the shared state of a single wc_uring_stream call*/
+typedef struct
+{
+    WCRing ring;
+    WCUringSlot* slots;
+    size_t window;
+    WCNameOf name_of;
+    WCCounted counted;
+    void* arg;
+} WCUring;
+
+/********************************************************************************
+ * moves the slot to its next operation: open -> read until EOF -> close. The fd
+ * is kept until its close completes. While draining a failed ring nothing new
+ * is queued, an open only keeps its fd so it can be closed and a read is
+ * dropped, the file is counted again with task.
+ ********************************************************************************/
+static void complete(WCUring* uring, const size_t slot, const int result, const bool draining)
+{
+    WCUringSlot* file = &uring->slots[slot];
+    switch (file->state)
+    {
+        case SLOT_OPENING:
+            if (result < 0)
+            {
+                file->state = SLOT_FINISHED;
+                uring->counted(uring->arg, slot, &file->counts, false);
+                return;
+            }
+            file->fd = result;
+            if (draining) { return; }
+            file->state = SLOT_READING;
+            queue_read(&uring->ring, slot, file);
+            return;
+        case SLOT_READING:
+            if (draining) { return; }
+            if (result > 0)
+            {
+                wc_count(&file->counts, file->buffer, result);
+                file->offset += result;
+                queue_read(&uring->ring, slot, file);
+                return;
+            }
+            file->state = SLOT_CLOSING; // a read error ends the stream like EOF does
+            queue_close(&uring->ring, slot, file->fd);
+            return;
+        case SLOT_CLOSING:
+            file->fd = -1;
+            file->state = SLOT_FINISHED;
+            uring->counted(uring->arg, slot, &file->counts, true);
+            return;
+        default:
+            return;
+    }
+}
+
+/*handles every completion in the completion ring*/
+static void reap(WCUring* uring, const bool draining)
+{
+    WCRing* ring = &uring->ring;
+    unsigned int head = *ring->cq_head;
+    const unsigned int tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    while (head != tail)
+    {
+        const struct io_uring_cqe* cqe = &ring->cqes[head & *ring->cq_mask];
+        const size_t slot = cqe->user_data;
+        const int result = cqe->res;
+        head++;
+        __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE); // the entry is copied, the kernel can reuse it
+        ring->in_flight--;
+        complete(uring, slot, result, draining);
+    }
+}
+
+/*waits for every operation that was submitted, so the fds of the opens that completed are known and closed*/
+static void drain(WCUring* uring)
+{
+    WCRing* ring = &uring->ring;
+    while (ring->in_flight > 0)
+    {
+        if (ring_enter(ring->fd, 0, 1) < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) { return; }
+        reap(uring, true);
+    }
+}
+
+/*the ring failed, the files in flight are counted again with task once the ring is drained and gone*/
+static void recover(WCUring* uring, const WCTask task)
+{
+    drain(uring);
+    ring_free(&uring->ring); // drops what was queued but never submitted
+    for (size_t slot = 0; slot < uring->window; slot++)
+    {
+        WCUringSlot* file = &uring->slots[slot];
+        if (file->state == SLOT_FREE || file->state == SLOT_FINISHED) { continue; }
+        if (file->fd >= 0) { close(file->fd); }
+        task(uring->arg, slot);
+        file->state = SLOT_FINISHED;
+    }
+}
+
+bool wc_uring_stream(const size_t window, const WCProducer next, const WCNameOf name_of, const WCCounted counted,
+                     const WCTask task, const WCTask done, void* arg)
+{
+    WCUring uring = {.window = window, .name_of = name_of, .counted = counted, .arg = arg};
+    if (window == 0 || !ring_init(&uring.ring, window)) { return false; }
+    uring.slots = calloc(window, sizeof(WCUringSlot));
+    unsigned char* buffers = aligned_alloc(4096, window * WC_URING_BUFFER);
+    if (uring.slots == NULL || buffers == NULL)
+    {
+        free(uring.slots);
+        free(buffers);
+        ring_free(&uring.ring);
+        return false;
+    }
+    for (size_t slot = 0; slot < window; slot++) { uring.slots[slot].buffer = buffers + slot * WC_URING_BUFFER; }
+
+    bool failed = false;
+    size_t produced = 0;
+    size_t consumed = 0;
+    bool ended = false;
+    for (;;)
+    {
+        while (consumed < produced && uring.slots[consumed % window].state == SLOT_FINISHED)
+        {
+            uring.slots[consumed % window].state = SLOT_FREE;
+            done(arg, consumed++ % window);
+        }
+        while (!ended && produced - consumed < window)
+        {
+            const size_t slot = produced % window;
+            if (!next(arg, slot))
+            {
+                ended = true;
+                break;
+            }
+            produced++;
+            uring.slots[slot] = (WCUringSlot){SLOT_OPENING, -1, 0, {0, 0, 0, 0, false}, uring.slots[slot].buffer};
+            if (failed)
+            {
+                task(arg, slot);
+                uring.slots[slot].state = SLOT_FINISHED;
+            }
+            else { queue_open(&uring.ring, slot, name_of(arg, slot)); }
+        }
+        if (ended && consumed == produced) { break; }
+        if (failed) { continue; }
+        if (!ring_submit_and_wait(&uring.ring))
+        {
+            failed = true;
+            recover(&uring, task);
+            continue;
+        }
+        reap(&uring, false);
+    }
+
+    if (!failed) { ring_free(&uring.ring); }
+    free(buffers);
+    free(uring.slots);
+    return true;
+}
+
+#else
+
+bool wc_uring_stream(const size_t window, const WCProducer next, const WCNameOf name_of, const WCCounted counted,
+                     const WCTask task, const WCTask done, void* arg)
+{
+    return false;
+}
+
+#endif
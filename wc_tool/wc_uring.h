@@ -0,0 +1,28 @@
+#ifndef WC_URING_H
+#define WC_URING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "wc_kernel.h"
+#include "wc_pool.h"
+
+/*returns the name of the file in the slot*/
+typedef const char* (*WCNameOf)(void* arg, size_t slot);
+
+/*receives the counts of the file in the slot, counted is false if the file could not be opened*/
+typedef void (*WCCounted)(void* arg, size_t slot, const WCCounts* counts, bool counted);
+
+/********************************************************************************
+ * counts a stream of files with io_uring on the calling thread, with the same
+ * contract as wc_parallel_stream: next fills a free slot, and done is called on
+ * the slots in the order they were produced. Every file in flight has an
+ * open, read, or close queued on the ring, so up to window files are waiting on
+ * the disk at once while the finished reads are counted.
+ * Returns false without calling anything if io_uring (with openat, read, and
+ * close) is not available. If the ring fails later on, the files in flight and
+ * the rest of the stream are counted with task on the calling thread.
+ ********************************************************************************/
+bool wc_uring_stream(size_t window, WCProducer next, WCNameOf name_of, WCCounted counted, WCTask task, WCTask done, void* arg);
+
+#endif